@@ -0,0 +1,78 @@
+// Bytes per AST node: the size of each node class, then what parsing a
+// reference program costs in the arena and in the flat form.
+// Usage: MonkeyAstMemoryReport [script]
+#include "../lexer/lexer.hpp"
+#include "../parser/flat_ast.hpp"
+#include "../parser/parser.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace monkey;
+using namespace monkey::parser::ast;
+
+namespace {
+
+// A mix of the node kinds real scripts use: bindings, closures, calls,
+// arithmetic and short identifiers.
+const char *kReferenceProgram = R"(
+let map = fn(arr, f) {
+  let iter = fn(a, acc) {
+    if (len(a) == 0) { acc } else { iter(rest(a), push(acc, f(first(a)))) }
+  };
+  iter(arr, [])
+};
+let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };
+let x = 1 + 2 * 3 - -4 / 5;
+let s = "hello" + " " + "world";
+let ys = map([1, 2, 3, 4], fn(v) { v * x });
+if (!(x > 10) == true) { fib(x) } else { s }
+)";
+
+template <typename T> void row(const char *name) {
+  std::cout << "  " << std::left << std::setw(20) << name << sizeof(T)
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::cout << "sizeof:" << std::endl;
+  row<Identifier>("Identifier");
+  row<IntegerLiteral>("IntegerLiteral");
+  row<Boolean>("Boolean");
+  row<StringLiteral>("StringLiteral");
+  row<PrefixExpression>("PrefixExpression");
+  row<InfixExpression>("InfixExpression");
+  row<IfExpression>("IfExpression");
+  row<FunctionLiteral>("FunctionLiteral");
+  row<CallExpression>("CallExpression");
+  row<ArrayLiteral>("ArrayLiteral");
+  row<LetStatement>("LetStatement");
+  row<ReturnStatement>("ReturnStatement");
+  row<ExpressionStatement>("ExpressionStatement");
+  row<BlockStatement>("BlockStatement");
+  row<parser::flat::Node>("flat::Node");
+
+  auto source = argc > 1 ? lexer::Source::mapFile(argv[1])
+                         : lexer::makeSource(kReferenceProgram);
+  lexer::Lexer l(source);
+  parser::Parser p(&l);
+  auto program = p.parseProgram();
+  auto tree = parser::flat::flatten(*program);
+  const auto &arena = *program->arena;
+  auto perNode = [&](size_t bytes) {
+    return static_cast<double>(bytes) / arena.nodes();
+  };
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "program: " << source->size() << " bytes of source, "
+            << arena.nodes() << " nodes" << std::endl;
+  std::cout << "  node objects    " << arena.nodeBytes() << " ("
+            << perNode(arena.nodeBytes()) << " per node)" << std::endl;
+  std::cout << "  arena reserved  " << arena.reserved() << " ("
+            << perNode(arena.reserved()) << " per node)" << std::endl;
+  std::cout << "  flat tree       " << tree.memoryUsage() << " ("
+            << perNode(tree.memoryUsage()) << " per node)" << std::endl;
+  return p.getErrors().empty() ? 0 : 1;
+}
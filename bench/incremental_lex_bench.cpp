@@ -0,0 +1,48 @@
+// Latency of re-lexing a large buffer after a one-character edit, compared
+// with lexing it from scratch.
+// Usage: MonkeyIncrementalLexBench [megabytes] [edits]
+#include "../lexer/incremental_lexer.hpp"
+#include "../lexer/lexer.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace monkey::lexer;
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+  int edits = argc > 2 ? std::atoi(argv[2]) : 20;
+  std::string script;
+  for (size_t i = 0; script.size() < (megabytes << 20); i++) {
+    auto n = std::to_string(i);
+    script += "let value" + n + " = fn(x) { x * " + n + " };\n";
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  auto tokens = Lexer(script).tokenizeAll();
+  std::chrono::duration<double> full = Clock::now() - start;
+
+  double total = 0;
+  size_t relexedTokens = 0;
+  for (int i = 0; i < edits; i++) {
+    // Rename an identifier somewhere in the middle of the buffer.
+    auto text = tokens.source()->text();
+    auto offset = text.find("value", text.size() / (edits + 1) * (i + 1));
+    start = Clock::now();
+    auto result = relex(tokens, {offset + 5, 0, "x"});
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    total += elapsed.count();
+    relexedTokens += result.newEnd - result.firstChanged;
+    tokens = std::move(result.tokens);
+  }
+  std::cout << "buffer: " << tokens.source()->size() << " bytes, "
+            << tokens.size() << " tokens" << std::endl;
+  std::cout << "full lex: " << full.count() * 1e3 << " ms" << std::endl;
+  std::cout << "relex per edit: " << total / edits * 1e3 << " ms, "
+            << double(relexedTokens) / edits << " tokens re-lexed"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,49 @@
+// Latency of reparsing a large script after a one-character edit inside one
+// function, compared with parsing it from scratch.
+// Usage: MonkeyIncrementalParseBench [megabytes] [edits]
+#include "../parser/incremental_parser.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace monkey;
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+  int edits = argc > 2 ? std::atoi(argv[2]) : 20;
+  std::string script;
+  for (size_t i = 0; script.size() < (megabytes << 20); i++) {
+    auto n = std::to_string(i);
+    script += "let value = fn(x) { if (x > " + n + ") { x * " + n +
+              " } else { [x, \"s\"] } };\n";
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  auto parsed = parser::parseScript(lexer::makeSource(script));
+  std::chrono::duration<double> full = Clock::now() - start;
+
+  double total = 0;
+  size_t reused = 0;
+  for (int i = 0; i < edits; i++) {
+    // Change a constant somewhere in the middle of the script.
+    auto text = parsed.tokens.source()->text();
+    auto offset = text.find("x * ", text.size() / (edits + 1) * (i + 1));
+    start = Clock::now();
+    auto result = parser::reparse(parsed, {offset + 4, 0, "1"});
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    total += elapsed.count();
+    reused += result.reusedStatements;
+    parsed = std::move(result);
+  }
+  std::cout << "script: " << parsed.tokens.source()->size() << " bytes, "
+            << parsed.program->statements.size() << " statements"
+            << std::endl;
+  std::cout << "full lex+parse: " << full.count() * 1e3 << " ms" << std::endl;
+  std::cout << "reparse per edit: " << total / edits * 1e3 << " ms, "
+            << parsed.program->statements.size() - double(reused) / edits
+            << " statements parsed again" << std::endl;
+  return parsed.errors.empty() ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+// Lexer throughput across the scanner implementations available on this CPU.
+// Usage: MonkeyLexerBench [megabytes] [repetitions]
+#include "../lexer/lexer.hpp"
+#include "../lexer/scan.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace monkey::lexer;
+
+std::string generateScript(size_t bytes) {
+  std::string script;
+  script.reserve(bytes + 256);
+  for (size_t i = 0; script.size() < bytes; i++) {
+    auto n = std::to_string(i);
+    script += "let configurationTableEntry = fn(previousValue, currentValue) "
+              "{\n        if (previousValue < currentValue) {\n"
+              "            return \"an entry description that is long\";\n"
+              "        }\n        previousValue * " +
+              n + " + currentValue / 1234567;\n    };\n\n";
+  }
+  return script;
+}
+
+size_t lexAll(const SourcePtr &source) {
+  Lexer lexer(source);
+  size_t count = 0;
+  while (lexer.nextToken().type != TokenType::EOFILE) {
+    count++;
+  }
+  return count;
+}
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+  auto source = makeSource(generateScript(megabytes << 20));
+
+  std::cout << "input: " << source->size() << " bytes, best isa: "
+            << scan::to_string(scan::bestSupportedIsa()) << std::endl;
+  for (auto isa : {scan::Isa::SCALAR, scan::Isa::SSE2, scan::Isa::AVX2}) {
+    if (scan::setIsa(isa) != isa) {
+      continue;
+    }
+    double best = 1e300;
+    size_t tokens = 0;
+    for (int i = 0; i < repetitions; i++) {
+      auto start = std::chrono::steady_clock::now();
+      tokens = lexAll(source);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+    }
+    std::cout << scan::to_string(isa) << ": " << tokens << " tokens, "
+              << best * 1e3 << " ms, " << (source->size() / 1e6) / best
+              << " MB/s" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+// Scaling of tokenizeParallel over a generated multi-megabyte let table.
+// Usage: MonkeyParallelLexBench [megabytes] [repetitions]
+#include "../lexer/lexer.hpp"
+#include "../lexer/parallel_lexer.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace monkey::lexer;
+
+std::string generateTable(size_t bytes) {
+  std::string script;
+  script.reserve(bytes + 256);
+  for (size_t i = 0; script.size() < bytes; i++) {
+    auto n = std::to_string(i);
+    script += "let entry" + n + " = [" + n + ", 0x" + n + ", \"label " + n +
+              "\", fn(x) { x * " + n + " + 1_000 }];\n";
+  }
+  return script;
+}
+
+double timeIt(int repetitions, auto fn) {
+  double best = 1e300;
+  for (int i = 0; i < repetitions; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+  auto source = makeSource(generateTable(megabytes << 20));
+  std::cout << "input: " << source->size() << " bytes, hardware threads: "
+            << std::thread::hardware_concurrency() << std::endl;
+
+  size_t tokens = 0;
+  auto sequential = timeIt(repetitions, [&] {
+    tokens = Lexer(source).tokenizeAll().size();
+  });
+  std::cout << "sequential: " << tokens << " tokens, " << sequential * 1e3
+            << " ms" << std::endl;
+  for (unsigned threads : {1, 2, 4, 8, 12, 16}) {
+    auto elapsed = timeIt(repetitions, [&] {
+      tokens = tokenizeParallel(source, threads).size();
+    });
+    std::cout << threads << " threads: " << elapsed * 1e3 << " ms, speedup "
+              << sequential / elapsed << "x" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+// Scaling of Parser::parseProgram(threads) over a generated multi-megabyte
+// script of top-level lets, lexed once up front.
+// Usage: MonkeyParallelParseBench [megabytes] [repetitions]
+#include "../lexer/parallel_lexer.hpp"
+#include "../parser/parser.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace monkey;
+
+double timeIt(int repetitions, auto fn) {
+  double best = 1e300;
+  for (int i = 0; i < repetitions; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+  std::string script;
+  for (size_t i = 0; script.size() < (megabytes << 20); i++) {
+    auto n = std::to_string(i);
+    script += "let entry = fn(x) { if (x > " + n + ") { x * " + n +
+              " } else { \"label " + n + "\" } };\n";
+  }
+  auto source = lexer::makeSource(std::move(script));
+  auto tokens = lexer::tokenizeParallel(source,
+                                        std::thread::hardware_concurrency());
+  std::cout << "input: " << source->size() << " bytes, " << tokens.size()
+            << " tokens, hardware threads: "
+            << std::thread::hardware_concurrency() << std::endl;
+
+  size_t statements = 0;
+  auto sequential = timeIt(repetitions, [&] {
+    statements = parser::Parser(&tokens).parseProgram()->statements.size();
+  });
+  std::cout << "sequential: " << statements << " statements, "
+            << sequential * 1e3 << " ms" << std::endl;
+  for (unsigned threads : {1, 2, 4, 8, 12, 16}) {
+    auto elapsed = timeIt(repetitions, [&] {
+      parser::Parser p(&tokens);
+      statements = p.parseProgram(threads)->statements.size();
+    });
+    std::cout << threads << " threads: " << elapsed * 1e3 << " ms, speedup "
+              << sequential / elapsed << "x" << std::endl;
+  }
+  return 0;
+}
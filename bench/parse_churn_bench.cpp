@@ -0,0 +1,56 @@
+// Parse-and-discard throughput: many small programs, then one large one,
+// each parsed and destroyed repeatedly. Allocation and teardown of the AST
+// dominate this workload.
+// Usage: MonkeyParseChurnBench [small programs] [large megabytes]
+#include "../lexer/lexer.hpp"
+#include "../parser/parser.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace monkey;
+
+int main(int argc, char **argv) {
+  size_t programs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  size_t megabytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8;
+  using Clock = std::chrono::steady_clock;
+
+  auto small = lexer::makeSource(
+      "let add = fn(a, b) { a + b }; let x = add(1, 2 * 3);"
+      "if (x > 5) { [x, x - 1, \"big\"] } else { return -x; }");
+  auto smallTokens = lexer::Lexer(small).tokenizeAll();
+  auto start = Clock::now();
+  size_t statements = 0;
+  for (size_t i = 0; i < programs; i++) {
+    parser::Parser p(&smallTokens);
+    statements += p.parseProgram()->statements.size();
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  std::cout << "small: " << programs << " programs, "
+            << elapsed.count() * 1e6 / programs << " us per parse+free"
+            << std::endl;
+
+  std::string script;
+  for (size_t i = 0; script.size() < (megabytes << 20); i++) {
+    auto n = std::to_string(i);
+    script += "let f" + n + " = fn(a, b) { if (a < b) { a * " + n +
+              " } else { [a, b, \"s\"] } };\n";
+  }
+  auto largeTokens = lexer::Lexer(script).tokenizeAll();
+  double parse = 0, destroy = 0;
+  for (int i = 0; i < 3; i++) {
+    start = Clock::now();
+    auto program = parser::Parser(&largeTokens).parseProgram();
+    auto parsed = Clock::now();
+    program.reset();
+    auto freed = Clock::now();
+    parse += std::chrono::duration<double>(parsed - start).count();
+    destroy += std::chrono::duration<double>(freed - parsed).count();
+  }
+  std::cout << "large: " << largeTokens.size() << " tokens, parse "
+            << parse / 3 * 1e3 << " ms, free " << destroy / 3 * 1e3 << " ms"
+            << std::endl;
+  return statements == 0;
+}
@@ -0,0 +1,71 @@
+// Parse wall time with lexing done up front versus overlapped with parsing
+// on a producer thread. On a machine with two or more cores the pipelined
+// time should approach max(lex, parse) rather than their sum.
+// Usage: MonkeyPipelineBench [megabytes] [repetitions]
+#include "../lexer/lexer.hpp"
+#include "../lexer/pipelined_lexer.hpp"
+#include "../parser/parser.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace monkey;
+
+std::string generateScript(size_t bytes) {
+  std::string script;
+  script.reserve(bytes + 256);
+  for (size_t i = 0; script.size() < bytes; i++) {
+    auto n = std::to_string(i);
+    script += "let entry" + n + " = fn(a, b) { if (a < b) { return \"lt\"; } a * " +
+              n + " + b / 7 };\n";
+  }
+  return script;
+}
+
+double timeIt(int repetitions, auto fn) {
+  double best = 1e300;
+  for (int i = 0; i < repetitions; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+  auto source = lexer::makeSource(generateScript(megabytes << 20));
+  std::cout << "input: " << source->size() << " bytes, hardware threads: "
+            << std::thread::hardware_concurrency() << std::endl;
+
+  lexer::TokenStream tokens;
+  auto lex = timeIt(repetitions,
+                    [&] { tokens = lexer::Lexer(source).tokenizeAll(); });
+  auto parse = timeIt(repetitions, [&] {
+    parser::Parser p(&tokens);
+    p.parseProgram();
+  });
+  auto sequential = timeIt(repetitions, [&] {
+    lexer::Lexer l(source);
+    parser::Parser p(&l);
+    p.parseProgram();
+  });
+  auto pipelined = timeIt(repetitions, [&] {
+    lexer::PipelinedLexer l(source);
+    parser::Parser p(&l);
+    p.parseProgram();
+  });
+  std::cout << "lex only: " << lex * 1e3 << " ms" << std::endl;
+  std::cout << "parse pre-lexed: " << parse * 1e3 << " ms" << std::endl;
+  std::cout << "lex+parse interleaved: " << sequential * 1e3 << " ms"
+            << std::endl;
+  std::cout << "lex+parse pipelined: " << pipelined * 1e3 << " ms"
+            << std::endl;
+  return 0;
+}
@@ -4,7 +4,7 @@
 #include <iostream>
 
 namespace monkey::evaluator {
-using Builtins = std::unordered_map<std::string, std::shared_ptr<Builtin>>;
+using Builtins = std::unordered_map<lexer::Symbol, std::shared_ptr<Builtin>>;
 
 inline Builtins create_builtins() {
 
@@ -24,7 +24,7 @@ inline Builtins create_builtins() {
     return makeError("argument to `len` not supported, got", args[0]->type());
   };
 
-  builtins.insert({"len", std::make_shared<Builtin>(len)});
+  builtins.insert({lexer::intern("len"), std::make_shared<Builtin>(len)});
   return builtins;
 }
 
@@ -2,9 +2,12 @@
 #include "builtins.hpp"
 #include <iostream>
 #include <sstream>
+#include <utility>
 
 namespace monkey::evaluator {
 
+using parser::ast::Op;
+
 const static auto TRUE = std::make_shared<Boolean>(true);
 const static auto FALSE = std::make_shared<Boolean>(false);
 const static auto NullObject = std::make_shared<Null>();
@@ -52,66 +55,70 @@ ObjectPtr evalMinusPrefixOperatorExpression(ObjectPtr right) {
   return std::make_shared<Integer>(-value);
 }
 
-ObjectPtr evalIntegerInfixExpression(const std::string &op, ObjectPtr left,
+ObjectPtr evalIntegerInfixExpression(Op op, ObjectPtr left,
                                      ObjectPtr right) {
   auto leftVal = static_cast<Integer *>(left.get())->value_;
   auto rightVal = static_cast<Integer *>(right.get())->value_;
-  if (op == "+") {
+  switch (op) {
+  case Op::PLUS:
     return std::make_shared<Integer>(leftVal + rightVal);
-  } else if (op == "-") {
+  case Op::MINUS:
     return std::make_shared<Integer>(leftVal - rightVal);
-  } else if (op == "*") {
+  case Op::ASTERISK:
     return std::make_shared<Integer>(leftVal * rightVal);
-  } else if (op == "/") {
+  case Op::SLASH:
     return std::make_shared<Integer>(leftVal / rightVal);
-  } else if (op == "<") {
+  case Op::LT:
     return getBoolean(leftVal < rightVal);
-  } else if (op == ">") {
+  case Op::GT:
     return getBoolean(leftVal > rightVal);
-  } else if (op == "==") {
+  case Op::EQ:
     return getBoolean(leftVal == rightVal);
-  } else if (op == "!=") {
+  case Op::NOT_EQ:
     return getBoolean(leftVal != rightVal);
-  } else {
-    return makeError("unknown operator: ", op, left->type(), right->type());
+  default:
+    return makeError("unknown operator: ", to_string(op), left->type(),
+                     right->type());
   }
 }
 
-ObjectPtr evalStringInfixExpression(const std::string &op, ObjectPtr left,
-                                    ObjectPtr right) {
+ObjectPtr evalStringInfixExpression(Op op, ObjectPtr left, ObjectPtr right) {
   auto leftVal = static_cast<String *>(left.get())->value_;
   auto rightVal = static_cast<String *>(right.get())->value_;
-  if (op == "+") {
+  if (op == Op::PLUS) {
     return std::make_shared<String>(leftVal + rightVal);
   } else {
-    return makeError("unknown operator:", left->type(), op, right->type());
+    return makeError("unknown operator:", left->type(), to_string(op),
+                     right->type());
   }
 }
 
-ObjectPtr evalPrefixExpression(const std::string &op, ObjectPtr right) {
-  if (op == "!") {
+ObjectPtr evalPrefixExpression(Op op, ObjectPtr right) {
+  switch (op) {
+  case Op::BANG:
     return evalBangOperatorExpression(right);
-  } else if (op == "-") {
+  case Op::MINUS:
     return evalMinusPrefixOperatorExpression(right);
-  } else {
-    return makeError("unknown operator:", op, right->type());
+  default:
+    return makeError("unknown operator:", to_string(op), right->type());
   }
 }
 
-ObjectPtr evalInfixExpression(const std::string &op, ObjectPtr left,
-                              ObjectPtr right) {
+ObjectPtr evalInfixExpression(Op op, ObjectPtr left, ObjectPtr right) {
   if (left->type() == INTEGER_OBJ && right->type() == INTEGER_OBJ) {
     return evalIntegerInfixExpression(op, left, right);
   } else if (left->type() == STRING_OBJ && right->type() == STRING_OBJ) {
     return evalStringInfixExpression(op, left, right);
-  } else if (op == "==") {
+  } else if (op == Op::EQ) {
     return getBoolean(left == right);
-  } else if (op == "!=") {
+  } else if (op == Op::NOT_EQ) {
     return getBoolean(left != right);
   } else if (left->type() != right->type()) {
-    return makeError("type mismatch:", left->type(), op, right->type());
+    return makeError("type mismatch:", left->type(), to_string(op),
+                     right->type());
   } else {
-    return makeError("unknown operator:", left->type(), op, right->type());
+    return makeError("unknown operator:", left->type(), to_string(op),
+                     right->type());
   }
 }
 
@@ -131,6 +138,31 @@ ObjectPtr Evaluator::evalProgram(const parser::ast::Statements &node,
   return result;
 }
 
+ObjectPtr Evaluator::eval(const parser::ParsedStatement &parsed,
+                          Environment env) {
+  keepAlive_ = parsed.arena;
+  auto result = doEval(parsed.statement, env);
+  keepAlive_ = nullptr;
+  return result;
+}
+
+ObjectPtr Evaluator::evalStream(parser::StatementStream &stream,
+                                Environment env) {
+  ObjectPtr result;
+  parser::ParsedStatement parsed;
+  while (stream.next(parsed)) {
+    result = eval(parsed, env);
+    if (result->type() == RETURN_VALUE_OBJ) {
+      result = static_cast<ReturnValue *>(result.get())->value_;
+      break;
+    }
+    if (result->type() == ERROR_OBJ) {
+      break;
+    }
+  }
+  return result;
+}
+
 ObjectPtr Evaluator::evalBlockStatement(const parser::ast::Statements &node,
                                         Environment env) {
   //   std::cout << "evaluating block statement" << std::endl;
@@ -147,39 +179,42 @@ ObjectPtr Evaluator::evalBlockStatement(const parser::ast::Statements &node,
   return result;
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::Statement *node, Environment env) {
+ObjectPtr Evaluator::doEval(const parser::ast::Statement *node,
+                            Environment env) {
   //   std::cout << "evaluating statement" << std::endl;
   switch (node->Type()) {
   case parser::ast::StatementType::LET:
-    return doEval(static_cast<parser::ast::LetStatement *>(node), env);
+    return doEval(static_cast<const parser::ast::LetStatement *>(node), env);
   case parser::ast::StatementType::RETURN:
-    return doEval(static_cast<parser::ast::ReturnStatement *>(node), env);
+    return doEval(static_cast<const parser::ast::ReturnStatement *>(node), env);
   case parser::ast::StatementType::EXPRESSION:
-    return doEval(static_cast<parser::ast::ExpressionStatement *>(node), env);
+    return doEval(
+        static_cast<const parser::ast::ExpressionStatement *>(node), env);
   default:
     return nullptr;
   }
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::ExpressionStatement *node,
+ObjectPtr Evaluator::doEval(const parser::ast::ExpressionStatement *node,
                             Environment env) {
   return eval(node->expression.get(), env);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::IntegerLiteral *node,
+ObjectPtr Evaluator::doEval(const parser::ast::IntegerLiteral *node,
                             Environment env) {
   return std::make_shared<Integer>(node->value);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::Boolean *node, Environment env) {
+ObjectPtr Evaluator::doEval(const parser::ast::Boolean *node, Environment env) {
   return getBoolean(node->value);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::StringLiteral *node, Environment env) {
-  return std::make_shared<String>(node->value);
+ObjectPtr Evaluator::doEval(const parser::ast::StringLiteral *node,
+                            Environment env) {
+  return std::make_shared<String>(std::string(node->value()));
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::InfixExpression *node,
+ObjectPtr Evaluator::doEval(const parser::ast::InfixExpression *node,
                             Environment env) {
   auto left = eval(node->left.get(), env);
   if (isError(left)) {
@@ -192,7 +227,7 @@ ObjectPtr Evaluator::doEval(parser::ast::InfixExpression *node,
   return evalInfixExpression(node->op, left, right);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::PrefixExpression *node,
+ObjectPtr Evaluator::doEval(const parser::ast::PrefixExpression *node,
                             Environment env) {
   auto right = eval(node->right.get(), env);
   if (isError(right)) {
@@ -201,7 +236,8 @@ ObjectPtr Evaluator::doEval(parser::ast::PrefixExpression *node,
   return evalPrefixExpression(node->op, right);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::IfExpression *node, Environment env) {
+ObjectPtr Evaluator::doEval(const parser::ast::IfExpression *node,
+                            Environment env) {
   auto condition = eval(node->condition.get(), env);
   if (isError(condition)) {
     return condition;
@@ -215,10 +251,11 @@ ObjectPtr Evaluator::doEval(parser::ast::IfExpression *node, Environment env) {
   }
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::FunctionLiteral *node,
+ObjectPtr Evaluator::doEval(const parser::ast::FunctionLiteral *node,
                             Environment env) {
-  return std::make_shared<Function>(std::move(node->parameters),
-                                    std::move(node->body), env);
+  return std::make_shared<Function>(node->parameters, node->body.get(), env,
+                                    keepAlive_,
+                                    node->resolved ? &node->slots : nullptr);
 }
 
 Results Evaluator::evalExpressions(const parser::ast::Arguments &args,
@@ -235,9 +272,16 @@ Results Evaluator::evalExpressions(const parser::ast::Arguments &args,
 }
 
 Environment extendFunctionEnv(Function *fn, const Results &args) {
+  if (fn->slots_ != nullptr) {
+    auto env = std::make_shared<EnvironmentImpl>(fn->env_, fn->slots_);
+    for (size_t i = 0; i < fn->parameters.size(); i++) {
+      env->slots_[fn->parameters[i]->slot] = args[i];
+    }
+    return env;
+  }
   auto env = new_enclosed_environment(fn->env_);
   for (size_t i = 0; i < fn->parameters.size(); i++) {
-    env->set(fn->parameters[i]->value, args[i]);
+    env->set(fn->parameters[i]->symbol, args[i]);
   }
   return env;
 }
@@ -251,7 +295,9 @@ ObjectPtr unwrapReturnValue(ObjectPtr obj) {
 
 ObjectPtr Evaluator::applyFunction(Function *fn, const Results &args) {
   auto extendedEnv = extendFunctionEnv(fn, args);
-  auto evaluated = eval(fn->body.get(), extendedEnv);
+  auto callerKeepAlive = std::exchange(keepAlive_, fn->keepAlive_);
+  auto evaluated = eval(fn->body, extendedEnv);
+  keepAlive_ = std::move(callerKeepAlive);
   return unwrapReturnValue(evaluated);
 }
 
@@ -270,7 +316,7 @@ ObjectPtr Evaluator::applyFunction(ObjectPtr fn, const Results &args) {
   }
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::CallExpression *node,
+ObjectPtr Evaluator::doEval(const parser::ast::CallExpression *node,
                             Environment env) {
   auto function = eval(node->function.get(), env);
   if (isError(function)) {
@@ -283,29 +329,56 @@ ObjectPtr Evaluator::doEval(parser::ast::CallExpression *node,
   return applyFunction(function, args);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::Identifier *node, Environment env) {
-  auto value = env->get(node->value);
-  if (value.found) {
-    return value.value;
+ObjectPtr Evaluator::doEval(const parser::ast::Identifier *node,
+                            Environment env) {
+  auto *scope = env.get();
+  switch (node->binding) {
+  case parser::ast::Binding::LOCAL: {
+    scope = scope->enclosing(node->depth);
+    const auto &value = scope->slots_[node->slot];
+    if (value != nullptr) {
+      return value;
+    }
+    // Its `let` has not run yet, so the name is looked up further out.
+    scope = scope->outer_.get();
+    break;
+  }
+  case parser::ast::Binding::GLOBAL:
+    scope = scope->enclosing(node->depth);
+    break;
+  case parser::ast::Binding::DYNAMIC:
+    break;
+  }
+  if (scope != nullptr) {
+    auto value = scope->get(node->symbol);
+    if (value.found) {
+      return value.value;
+    }
   }
 
-  auto builtin = builtins.find(node->value);
+  auto builtin = builtins.find(node->symbol);
   if (builtin != builtins.end()) {
     return builtin->second;
   }
-  return makeError("identifier not found:", node->value);
+  return makeError("identifier not found:", node->value());
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::LetStatement *node, Environment env) {
+ObjectPtr Evaluator::doEval(const parser::ast::LetStatement *node,
+                            Environment env) {
   auto value = eval(node->value.get(), env);
   if (isError(value)) {
     return value;
   }
-  env->set(node->name->value, value);
+  const auto &name = *node->name;
+  if (name.binding == parser::ast::Binding::LOCAL) {
+    env->enclosing(name.depth)->slots_[name.slot] = value;
+  } else {
+    env->set(name.symbol, value);
+  }
   return value;
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::ReturnStatement *node,
+ObjectPtr Evaluator::doEval(const parser::ast::ReturnStatement *node,
                             Environment env) {
   auto value = eval(node->returnValue.get(), env);
   if (isError(value)) {
@@ -314,27 +387,29 @@ ObjectPtr Evaluator::doEval(parser::ast::ReturnStatement *node,
   return std::make_shared<ReturnValue>(value);
 }
 
-ObjectPtr Evaluator::doEval(parser::ast::Expression *node, Environment env) {
+ObjectPtr Evaluator::doEval(const parser::ast::Expression *node,
+                            Environment env) {
   // std::cout << "evaluating expression" << (int)node->Type() << std::endl;
   switch (node->Type()) {
   case parser::ast::ExpressionType::IDENTIFIER:
-    return doEval(static_cast<parser::ast::Identifier *>(node), env);
+    return doEval(static_cast<const parser::ast::Identifier *>(node), env);
   case parser::ast::ExpressionType::INTEGER:
-    return doEval(static_cast<parser::ast::IntegerLiteral *>(node), env);
+    return doEval(static_cast<const parser::ast::IntegerLiteral *>(node), env);
   case parser::ast::ExpressionType::BOOLEAN:
-    return doEval(static_cast<parser::ast::Boolean *>(node), env);
+    return doEval(static_cast<const parser::ast::Boolean *>(node), env);
   case parser::ast::ExpressionType::PREFIX:
-    return doEval(static_cast<parser::ast::PrefixExpression *>(node), env);
+    return doEval(
+        static_cast<const parser::ast::PrefixExpression *>(node), env);
   case parser::ast::ExpressionType::INFIX:
-    return doEval(static_cast<parser::ast::InfixExpression *>(node), env);
+    return doEval(static_cast<const parser::ast::InfixExpression *>(node), env);
   case parser::ast::ExpressionType::IF:
-    return doEval(static_cast<parser::ast::IfExpression *>(node), env);
+    return doEval(static_cast<const parser::ast::IfExpression *>(node), env);
   case parser::ast::ExpressionType::FUNCTION:
-    return doEval(static_cast<parser::ast::FunctionLiteral *>(node), env);
+    return doEval(static_cast<const parser::ast::FunctionLiteral *>(node), env);
   case parser::ast::ExpressionType::CALL:
-    return doEval(static_cast<parser::ast::CallExpression *>(node), env);
+    return doEval(static_cast<const parser::ast::CallExpression *>(node), env);
   case parser::ast::ExpressionType::STRING:
-    return doEval(static_cast<parser::ast::StringLiteral *>(node), env);
+    return doEval(static_cast<const parser::ast::StringLiteral *>(node), env);
   default:
     return nullptr;
   }
@@ -1,5 +1,6 @@
 #pragma once
 #include "../parser/ast.hpp"
+#include "../parser/statement_stream.hpp"
 #include "builtins.hpp"
 #include "object.hpp"
 #include <iostream>
@@ -10,6 +11,14 @@ public:
   Evaluator();
   ~Evaluator() = default;
   ObjectPtr eval(monkey::parser::ast::AstNode auto *node, Environment env);
+  // A statement from a StatementStream; functions it creates keep its
+  // arena alive.
+  ObjectPtr eval(const parser::ParsedStatement &parsed, Environment env);
+  // Evaluates a script statement by statement as the stream hands them
+  // out, with the result evalProgram would give for the statements it
+  // got. Each statement is released once evaluated, unless a function it
+  // created is still around. The caller checks stream.errors().
+  ObjectPtr evalStream(parser::StatementStream &stream, Environment env);
 
 private:
   ObjectPtr evalProgram(const parser::ast::Statements &node, Environment env);
@@ -20,22 +29,26 @@ private:
   ObjectPtr applyFunction(Function *fn, const Results &args);
   ObjectPtr applyBuiltin(Builtin *fn, const Results &args);
 
-  ObjectPtr doEval(parser::ast::Statement *node, Environment env);
-  ObjectPtr doEval(parser::ast::Expression *node, Environment env);
-  ObjectPtr doEval(parser::ast::IntegerLiteral *node, Environment env);
-  ObjectPtr doEval(parser::ast::Boolean *node, Environment env);
-  ObjectPtr doEval(parser::ast::PrefixExpression *node, Environment env);
-  ObjectPtr doEval(parser::ast::InfixExpression *node, Environment env);
-  ObjectPtr doEval(parser::ast::IfExpression *node, Environment env);
-  ObjectPtr doEval(parser::ast::FunctionLiteral *node, Environment env);
-  ObjectPtr doEval(parser::ast::CallExpression *node, Environment env);
-  ObjectPtr doEval(parser::ast::Identifier *node, Environment env);
-  ObjectPtr doEval(parser::ast::LetStatement *node, Environment env);
-  ObjectPtr doEval(parser::ast::ReturnStatement *node, Environment env);
-  ObjectPtr doEval(parser::ast::ExpressionStatement *node, Environment env);
-  ObjectPtr doEval(parser::ast::StringLiteral *node, Environment env);
+  ObjectPtr doEval(const parser::ast::Statement *node, Environment env);
+  ObjectPtr doEval(const parser::ast::Expression *node, Environment env);
+  ObjectPtr doEval(const parser::ast::IntegerLiteral *node, Environment env);
+  ObjectPtr doEval(const parser::ast::Boolean *node, Environment env);
+  ObjectPtr doEval(const parser::ast::PrefixExpression *node, Environment env);
+  ObjectPtr doEval(const parser::ast::InfixExpression *node, Environment env);
+  ObjectPtr doEval(const parser::ast::IfExpression *node, Environment env);
+  ObjectPtr doEval(const parser::ast::FunctionLiteral *node, Environment env);
+  ObjectPtr doEval(const parser::ast::CallExpression *node, Environment env);
+  ObjectPtr doEval(const parser::ast::Identifier *node, Environment env);
+  ObjectPtr doEval(const parser::ast::LetStatement *node, Environment env);
+  ObjectPtr doEval(const parser::ast::ReturnStatement *node, Environment env);
+  ObjectPtr doEval(const parser::ast::ExpressionStatement *node,
+                   Environment env);
+  ObjectPtr doEval(const parser::ast::StringLiteral *node, Environment env);
 
   Builtins builtins;
+  // Arena of the program whose nodes are currently being evaluated; handed
+  // to every Function created so its body outlives the Program.
+  std::shared_ptr<const void> keepAlive_;
 };
 
 ObjectPtr Evaluator::eval(monkey::parser::ast::AstNode auto *node,
@@ -51,6 +64,7 @@ ObjectPtr Evaluator::eval(monkey::parser::ast::AstNode auto *node,
       std::is_same_v<parser::ast::Expression, std::decay_t<decltype(*node)>>;
 
   if constexpr (isProram) {
+    keepAlive_ = node->arena;
     return evalProgram(node->statements, env);
   } else if constexpr (isBlockStatements) {
     return evalBlockStatement(node->statements, env);
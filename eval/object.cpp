@@ -3,7 +3,7 @@
 
 namespace monkey::evaluator {
 
-Integer::Integer(int value) : value_(value) {}
+Integer::Integer(int64_t value) : value_(value) {}
 
 std::string Integer::to_string() const { return std::to_string(value_); }
 
@@ -31,11 +31,12 @@ std::string Error::type() const { return ERROR_OBJ; }
 
 Error::Error(std::string message) : message_(std::move(message)) {}
 
-Function::Function(parser::ast::Parameters params,
-                   std::unique_ptr<parser::ast::BlockStatement> bod,
-                   Environment env)
-    : parameters(std::move(params)), body(std::move(bod)),
-      env_(std::move(env)) {}
+Function::Function(const parser::ast::Parameters &params,
+                   const parser::ast::BlockStatement *bod, Environment env,
+                   std::shared_ptr<const void> keepAlive,
+                   const parser::ast::Symbols *slots)
+    : parameters(params), body(bod), env_(std::move(env)),
+      keepAlive_(std::move(keepAlive)), slots_(slots) {}
 
 std::string Function::to_string() const {
   std::ostringstream oss;
@@ -57,25 +58,50 @@ std::string Function::type() const { return FUNCTION_OBJ; }
 EnvironmentImpl::EnvironmentImpl() : outer_(nullptr) {}
 EnvironmentImpl::EnvironmentImpl(std::shared_ptr<EnvironmentImpl> outer)
     : outer_(std::move(outer)) {}
+EnvironmentImpl::EnvironmentImpl(std::shared_ptr<EnvironmentImpl> outer,
+                                 const parser::ast::Symbols *names)
+    : slots_(names->size()), slotNames_(names), outer_(std::move(outer)) {}
 
 Environment new_enclosed_environment(Environment outer) {
   return std::make_shared<EnvironmentImpl>(std::move(outer));
 }
 
-EnvironmentImpl::StoreData EnvironmentImpl::get(const std::string &name) {
+ObjectPtr *EnvironmentImpl::slot(lexer::Symbol name) {
+  if (slotNames_ != nullptr) {
+    for (size_t i = 0; i < slotNames_->size(); i++) {
+      if ((*slotNames_)[i] == name) {
+        return &slots_[i];
+      }
+    }
+  }
+  return nullptr;
+}
+
+EnvironmentImpl::StoreData EnvironmentImpl::get(lexer::Symbol name) {
 
   auto it = store_.find(name);
 
   if (it != store_.end()) {
     return StoreData{.value = it->second, .found = true};
+  } else if (auto *value = slot(name); value != nullptr && *value) {
+    return StoreData{.value = *value, .found = true};
   } else if (outer_ != nullptr) {
     return outer_->get(name);
   }
   return StoreData{.value = nullptr, .found = false};
 }
 
-ObjectPtr EnvironmentImpl::set(const std::string &name, ObjectPtr value) {
-  store_.insert_or_assign(name, value);
+ObjectPtr EnvironmentImpl::set(lexer::Symbol name, ObjectPtr value) {
+  if (auto *bound = slot(name)) {
+    *bound = value;
+    return value;
+  }
+  auto it = store_.find(name);
+  if (it != store_.end()) {
+    it->second = value;
+  } else {
+    store_.emplace(name, value);
+  }
   return value;
 }
 
@@ -4,6 +4,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -32,11 +33,11 @@ using Results = std::vector<ObjectPtr>;
 
 class Integer : public Object {
 public:
-  explicit Integer(int value);
+  explicit Integer(int64_t value);
   ~Integer() override = default;
   std::string to_string() const override;
   std::string type() const override;
-  int value_;
+  int64_t value_;
 };
 
 class Boolean : public Object {
@@ -76,32 +77,58 @@ public:
 
 class EnvironmentImpl {
 public:
-  using Store = std::unordered_map<std::string, ObjectPtr>;
+  using Store = std::unordered_map<lexer::Symbol, ObjectPtr>;
   struct StoreData {
     ObjectPtr value;
     bool found;
   };
   explicit EnvironmentImpl();
   explicit EnvironmentImpl(std::shared_ptr<EnvironmentImpl> outer);
+  // For a call to a resolved function; names are its slots.
+  EnvironmentImpl(std::shared_ptr<EnvironmentImpl> outer,
+                  const parser::ast::Symbols *names);
   ~EnvironmentImpl() = default;
-  StoreData get(const std::string &name);
-  ObjectPtr set(const std::string &name, ObjectPtr value);
-  std::unordered_map<std::string, ObjectPtr> store_;
+  StoreData get(lexer::Symbol name);
+  ObjectPtr set(lexer::Symbol name, ObjectPtr value);
+  // The environment depth steps out from this one.
+  EnvironmentImpl *enclosing(size_t depth) {
+    auto *env = this;
+    for (; depth > 0; depth--) {
+      env = env->outer_.get();
+    }
+    return env;
+  }
+  Store store_;
+  // Values of a resolved function's slots, null until bound.
+  std::vector<ObjectPtr> slots_;
+  const parser::ast::Symbols *slotNames_ = nullptr;
   std::shared_ptr<EnvironmentImpl> outer_;
+
+private:
+  // The slot named name, if this environment has one.
+  ObjectPtr *slot(lexer::Symbol name);
 };
 
 using Environment = std::shared_ptr<EnvironmentImpl>;
 
 class Function : public Object {
 public:
-  Function(parser::ast::Parameters params,
-           std::unique_ptr<parser::ast::BlockStatement> body, Environment env);
+  Function(const parser::ast::Parameters &params,
+           const parser::ast::BlockStatement *body, Environment env,
+           std::shared_ptr<const void> keepAlive,
+           const parser::ast::Symbols *slots = nullptr);
   ~Function() override = default;
   std::string to_string() const override;
   std::string type() const override;
-  parser::ast::Parameters parameters;
-  std::unique_ptr<parser::ast::BlockStatement> body;
+  // Borrowed from the FunctionLiteral, which may be evaluated many times.
+  const parser::ast::Parameters &parameters;
+  const parser::ast::BlockStatement *body;
   Environment env_;
+  // Keeps the arena holding the literal, and the source it points into,
+  // alive.
+  std::shared_ptr<const void> keepAlive_;
+  // The literal's slots if its scope was resolved, else null.
+  const parser::ast::Symbols *slots_;
 };
 
 class String : public Object {
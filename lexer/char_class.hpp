@@ -0,0 +1,71 @@
+#pragma once
+#include "token.hpp"
+#include <array>
+#include <cstdint>
+
+namespace monkey::lexer {
+
+// What a byte can start. Drives the dispatch in Lexer::nextToken.
+enum class CharClass : uint8_t {
+  ILLEGAL,
+  END,        // NUL, also returned past the end of the input
+  WHITESPACE, // the "C" locale std::isspace set
+  LETTER,     // ASCII letter, starts an identifier or keyword
+  DIGIT,
+  QUOTE,
+  SINGLE,     // a one-byte token
+  WITH_EQUAL, // one-byte token that becomes another when followed by '='
+  NON_ASCII,  // lead or continuation byte of a multi-byte UTF-8 sequence
+};
+
+struct CharInfo {
+  CharClass cls = CharClass::ILLEGAL;
+  TokenType token = TokenType::ILLEGAL;     // for SINGLE and WITH_EQUAL
+  TokenType withEqual = TokenType::ILLEGAL; // for WITH_EQUAL
+};
+
+constexpr std::array<CharInfo, 256> makeCharTable() {
+  std::array<CharInfo, 256> table{};
+  table['\0'] = {CharClass::END};
+  for (auto ch : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+    table[static_cast<unsigned char>(ch)] = {CharClass::WHITESPACE};
+  }
+  for (int ch = 'a'; ch <= 'z'; ch++) {
+    table[ch] = {CharClass::LETTER};
+    table[ch - 'a' + 'A'] = {CharClass::LETTER};
+  }
+  for (int ch = '0'; ch <= '9'; ch++) {
+    table[ch] = {CharClass::DIGIT};
+  }
+  for (int ch = 0x80; ch <= 0xFF; ch++) {
+    table[ch] = {CharClass::NON_ASCII};
+  }
+  table['"'] = {CharClass::QUOTE};
+  table['='] = {CharClass::WITH_EQUAL, TokenType::ASSIGN, TokenType::EQ};
+  table['!'] = {CharClass::WITH_EQUAL, TokenType::BANG, TokenType::NOT_EQ};
+  table['+'] = {CharClass::SINGLE, TokenType::PLUS};
+  table['-'] = {CharClass::SINGLE, TokenType::MINUS};
+  table['*'] = {CharClass::SINGLE, TokenType::ASTERISK};
+  table['/'] = {CharClass::SINGLE, TokenType::SLASH};
+  table['<'] = {CharClass::SINGLE, TokenType::LT};
+  table['>'] = {CharClass::SINGLE, TokenType::GT};
+  table[','] = {CharClass::SINGLE, TokenType::COMMA};
+  table[';'] = {CharClass::SINGLE, TokenType::SEMICOLON};
+  table['('] = {CharClass::SINGLE, TokenType::LPAREN};
+  table[')'] = {CharClass::SINGLE, TokenType::RPAREN};
+  table['{'] = {CharClass::SINGLE, TokenType::LBRACE};
+  table['}'] = {CharClass::SINGLE, TokenType::RBRACE};
+  table['['] = {CharClass::SINGLE, TokenType::LBRACKET};
+  table[']'] = {CharClass::SINGLE, TokenType::RBRACKET};
+  return table;
+}
+
+inline constexpr std::array<CharInfo, 256> charTable = makeCharTable();
+
+constexpr const CharInfo &charInfo(char ch) {
+  return charTable[static_cast<unsigned char>(ch)];
+}
+
+constexpr CharClass charClass(char ch) { return charInfo(ch).cls; }
+
+} // namespace monkey::lexer
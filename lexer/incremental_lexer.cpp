@@ -0,0 +1,112 @@
+#include "incremental_lexer.hpp"
+#include "lexer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace monkey::lexer {
+
+namespace {
+// Bytes past a token's end the lexer may decode to decide where it stops.
+constexpr size_t lookahead = 4;
+
+// Byte range a token was lexed from. A string literal's span excludes its
+// quotes, so it covers one byte either side of it, even when empty; an
+// empty ILLEGAL or EOFILE token still consumed (or stopped at) one byte.
+size_t regionStart(const TokenStream &tokens, size_t i) {
+  auto start = tokens.start(i);
+  return tokens.type(i) == TokenType::STRING ? start - 1 : start;
+}
+
+size_t regionEnd(const TokenStream &tokens, size_t i) {
+  size_t end = size_t(tokens.start(i)) + tokens.length(i);
+  if (tokens.type(i) == TokenType::STRING) {
+    // An unterminated literal has no closing quote to cover.
+    return std::min(end + 1, tokens.source()->size());
+  }
+  return tokens.length(i) == 0 ? end + 1 : end;
+}
+} // namespace
+
+Relexed relex(const TokenStream &old, const TextEdit &edit) {
+  if (old.source() == nullptr || old.size() == 0) {
+    throw std::invalid_argument("relex needs a stream ending in EOFILE");
+  }
+  auto oldText = old.source()->text();
+  if (edit.offset > oldText.size() ||
+      edit.removed > oldText.size() - edit.offset) {
+    throw std::out_of_range("edit outside of the source text");
+  }
+  std::string text;
+  text.reserve(oldText.size() - edit.removed + edit.inserted.size());
+  text.append(oldText.substr(0, edit.offset));
+  text.append(edit.inserted);
+  text.append(oldText.substr(edit.offset + edit.removed));
+  auto source = makeSource(std::move(text));
+  auto shift = static_cast<int64_t>(edit.inserted.size()) -
+               static_cast<int64_t>(edit.removed);
+
+  // A token is reusable only if every byte the lexer looked at, including
+  // the character past its end that terminated it (up to four bytes of
+  // UTF-8), lies before the edit. Region ends grow with the token index, so
+  // the first affected token is found by binary search. The final EOFILE is
+  // always re-lexed.
+  size_t low = 0, high = old.size() - 1;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (regionEnd(old, mid) + lookahead <= edit.offset) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  size_t firstChanged = low;
+  size_t restart = firstChanged == 0 ? 0 : regionEnd(old, firstChanged - 1);
+
+  // Old tokens that start past the removed text are resync candidates.
+  size_t editEnd = edit.offset + edit.removed;
+  size_t oldEnd = firstChanged;
+  while (oldEnd < old.size() && regionStart(old, oldEnd) < editEnd) {
+    oldEnd++;
+  }
+
+  Relexed result{TokenStream(source), firstChanged, old.size(), 0};
+  result.tokens.reserve(old.size() + edit.inserted.size() / 5 + 1);
+  result.tokens.append(old, 0, firstChanged, 0);
+
+  size_t insertedEnd = edit.offset + edit.inserted.size();
+  Lexer lexer(source, restart, source->size());
+  TokenStream fresh(source);
+  while (true) {
+    auto tok = lexer.nextToken();
+    fresh.push(tok);
+    size_t last = fresh.size() - 1;
+    size_t start = regionStart(fresh, last);
+    if (start >= insertedEnd) {
+      // Past the edit the text is unchanged, so a token starting where an
+      // old one did will be followed by the same tokens as before.
+      while (oldEnd < old.size() &&
+             static_cast<int64_t>(regionStart(old, oldEnd)) + shift <
+                 static_cast<int64_t>(start)) {
+        oldEnd++;
+      }
+      if (oldEnd < old.size() &&
+          static_cast<int64_t>(regionStart(old, oldEnd)) + shift ==
+              static_cast<int64_t>(start) &&
+          old.type(oldEnd) == tok.type) {
+        result.tokens.append(fresh, 0, last, 0);
+        result.newEnd = result.tokens.size();
+        result.oldEnd = oldEnd;
+        result.tokens.append(old, oldEnd, old.size(), shift);
+        return result;
+      }
+    }
+    if (tok.type == TokenType::EOFILE) {
+      break;
+    }
+  }
+  result.tokens.append(fresh, 0, fresh.size(), 0);
+  result.newEnd = result.tokens.size();
+  return result;
+}
+
+} // namespace monkey::lexer
@@ -0,0 +1,44 @@
+#pragma once
+#include "source.hpp"
+#include "token_stream.hpp"
+#include <cstddef>
+#include <string>
+
+namespace monkey::lexer {
+
+// Replaces text[offset, offset + removed) with inserted.
+struct TextEdit {
+  size_t offset;
+  size_t removed;
+  std::string inserted;
+};
+
+// The tokens of an edited buffer. Old tokens [0, firstChanged) were kept as
+// they were, old tokens [oldEnd, old.size()) were kept with their offsets
+// shifted, and only new tokens [firstChanged, newEnd) were lexed again.
+struct Relexed {
+  TokenStream tokens;
+  size_t firstChanged;
+  size_t oldEnd;
+  size_t newEnd;
+};
+
+// Applies edit to old.source() and re-lexes from the last token before the
+// edit that cannot have seen it, stopping as soon as a token starts where an
+// unchanged old token started. The result is exactly what tokenizeAll on
+// the edited text would produce.
+//
+// Only the lexing is proportional to the edit. The edited text is still
+// built as one new Source, and the kept tokens are copied into the new
+// stream, the ones after the edit with their offsets shifted; both are
+// O(buffer) memory copies. They are several times cheaper than lexing
+// (about 20 ms against 110 ms for 8 MB), but the latency of an edit still
+// grows with the buffer. Making it independent of it would need offsets
+// relative to segments and a chunked source.
+//
+// old must be a complete stream ending in EOFILE; throws
+// std::invalid_argument for an empty one, and std::out_of_range for an
+// edit outside its text.
+Relexed relex(const TokenStream &old, const TextEdit &edit);
+
+} // namespace monkey::lexer
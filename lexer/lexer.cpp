@@ -1,11 +1,58 @@
 #include "lexer.hpp"
+#include "char_class.hpp"
+#include "scan.hpp"
+#include "symbol.hpp"
 #include "token.hpp"
-#include <cctype>
+#include "utf8.hpp"
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <string>
 
 namespace monkey::lexer {
 
-Lexer::Lexer(const std::string &input)
-    : input_(input), position_(0), read_position_(0), ch_('\0') {
+namespace {
+std::optional<LexError> decodeInteger(std::string_view body, int base,
+                                      bool separated, int64_t &value) {
+  if (body.empty() || body.front() == '_' || body.back() == '_') {
+    return LexError::MALFORMED_NUMBER;
+  }
+  std::string digits;
+  if (separated) {
+    if (body.find("__") != std::string_view::npos) {
+      return LexError::MALFORMED_NUMBER;
+    }
+    digits.reserve(body.size());
+    for (char ch : body) {
+      if (ch != '_') {
+        digits.push_back(ch);
+      }
+    }
+    body = digits;
+  }
+  auto [end, ec] =
+      std::from_chars(body.data(), body.data() + body.size(), value, base);
+  if (ec == std::errc::result_out_of_range) {
+    return LexError::NUMBER_OUT_OF_RANGE;
+  }
+  if (ec != std::errc() || end != body.data() + body.size()) {
+    return LexError::MALFORMED_NUMBER;
+  }
+  return std::nullopt;
+}
+} // namespace
+
+Lexer::Lexer(std::string input) : Lexer(makeSource(std::move(input))) {}
+
+Lexer::Lexer(SourcePtr source)
+    : source_(std::move(source)), input_(source_->text()), position_(0),
+      read_position_(0), ch_('\0') {
+  readChar();
+}
+
+Lexer::Lexer(SourcePtr source, size_t begin, size_t end)
+    : source_(std::move(source)), input_(source_->text().substr(0, end)),
+      position_(begin), read_position_(begin), ch_('\0') {
   readChar();
 }
 
@@ -19,126 +66,178 @@ void Lexer::readChar() {
   read_position_++;
 }
 
+void Lexer::jumpTo(size_t position) {
+  position_ = position;
+  read_position_ = position + 1;
+  ch_ = position < input_.length() ? input_[position] : '\0';
+}
+
 lexer::Token Lexer::nextToken() {
   Token tok;
 
   skipWhitespace();
 
-  switch (ch_) {
-  case '=':
-    if (peekChar() == '=') {
-      readChar();
-      tok = Token(TokenType::EQ, "==");
-    } else {
-      tok = Token(TokenType::ASSIGN, "=");
-    }
-    break;
-  case '+':
-    tok = Token(TokenType::PLUS, "+");
-    break;
-  case '-':
-    tok = Token(TokenType::MINUS, "-");
+  const auto &info = charInfo(ch_);
+  switch (info.cls) {
+  case CharClass::SINGLE:
+    tok = Token(info.token, input_.substr(position_, 1));
     break;
-  case '!':
+  case CharClass::WITH_EQUAL:
     if (peekChar() == '=') {
       readChar();
-      tok = Token(TokenType::NOT_EQ, "!=");
+      tok = Token(info.withEqual, input_.substr(position_ - 1, 2));
     } else {
-      tok = Token(TokenType::BANG, "!");
+      tok = Token(info.token, input_.substr(position_, 1));
     }
     break;
-  case '/':
-    tok = Token(TokenType::SLASH, "/");
-    break;
-  case '*':
-    tok = Token(TokenType::ASTERISK, "*");
-    break;
-  case '<':
-    tok = Token(TokenType::LT, "<");
-    break;
-  case '>':
-    tok = Token(TokenType::GT, ">");
-    break;
-  case ';':
-    tok = Token(TokenType::SEMICOLON, ";");
-    break;
-  case '(':
-    tok = Token(TokenType::LPAREN, "(");
-    break;
-  case ')':
-    tok = Token(TokenType::RPAREN, ")");
-    break;
-  case ',':
-    tok = Token(TokenType::COMMA, ",");
-    break;
-  case '{':
-    tok = Token(TokenType::LBRACE, "{");
-    break;
-  case '}':
-    tok = Token(TokenType::RBRACE, "}");
-    break;
-  case '[':
-    tok = Token(TokenType::LBRACKET, "[");
-    break;
-  case ']':
-    tok = Token(TokenType::RBRACKET, "]");
+  case CharClass::END:
+    tok = Token(TokenType::EOFILE,
+                input_.substr(std::min(position_, input_.size()), 0));
     break;
-  case '\0':
-    tok = Token(TokenType::EOFILE, "");
-    break;
-  case '"':
+  case CharClass::QUOTE:
     tok.type = TokenType::STRING;
     tok.literal = readString();
+    if (!utf8::isValid(tok.literal)) {
+      // Report the whole literal, quotes included, as one bad token.
+      size_t start = tok.literal.data() - input_.data() - 1;
+      size_t end = ch_ == '"' ? position_ + 1 : position_;
+      tok = Token(TokenType::ILLEGAL, input_.substr(start, end - start),
+                  static_cast<int64_t>(LexError::INVALID_UTF8));
+    }
     break;
-  default:
-    if (std::isalpha(ch_)) {
-      tok.literal = readIdentifier();
-      tok.type = LookupIdent(tok.literal);
-      return tok;
-    } else if (isdigit(ch_)) {
-      tok.type = TokenType::INT;
-      tok.literal = readNumber();
-      return tok;
-    } else {
-      tok.type = TokenType::ILLEGAL;
-      tok.literal = "";
+  case CharClass::NON_ASCII:
+    return readNonAscii();
+  case CharClass::LETTER:
+    tok.literal = readIdentifier();
+    tok.type = LookupIdent(tok.literal);
+    if (tok.type == TokenType::IDENT) {
+      tok.payload = symbol(tok.literal);
     }
+    return tok;
+  case CharClass::DIGIT:
+    return readNumber();
+  case CharClass::WHITESPACE:
+  case CharClass::ILLEGAL:
+    tok = Token(TokenType::ILLEGAL, input_.substr(position_, 0),
+                static_cast<int64_t>(LexError::UNEXPECTED_CHARACTER));
+    break;
   }
 
   readChar();
   return tok;
 }
 
-std::string Lexer::readIdentifier() {
-  int start = position_;
-  while (std::isalpha(ch_)) {
-    readChar();
+TokenStream Lexer::tokenizeAll() {
+  TokenStream tokens(source_);
+  // Typical scripts average a token every five or six bytes.
+  tokens.reserve(input_.size() / 5 + 1);
+  Token tok;
+  do {
+    tok = nextToken();
+    tokens.push(tok);
+  } while (tok.type != TokenType::EOFILE);
+  return tokens;
+}
+
+// Identifiers are ASCII letters plus any non-ASCII XID_Continue characters.
+// ASCII runs are scanned as before; only a non-ASCII byte after one takes
+// the decoding path.
+std::string_view Lexer::readIdentifier() {
+  size_t start = position_;
+  size_t end = scan::skipAlpha(input_, position_);
+  while (end < input_.size() && charClass(input_[end]) == CharClass::NON_ASCII) {
+    char32_t codePoint;
+    auto length = utf8::decode(input_, end, codePoint);
+    if (length == 0 || !utf8::isXidContinue(codePoint)) {
+      break;
+    }
+    end = scan::skipAlpha(input_, end + length);
   }
+  jumpTo(end);
   return input_.substr(start, position_ - start);
 }
 
+// A non-ASCII character outside a string either starts an identifier
+// (XID_Start) or is a single ILLEGAL token covering the whole sequence.
+lexer::Token Lexer::readNonAscii() {
+  char32_t codePoint;
+  auto length = utf8::decode(input_, position_, codePoint);
+  if (length != 0 && utf8::isXidStart(codePoint)) {
+    auto literal = readIdentifier();
+    return Token(TokenType::IDENT, literal, symbol(literal));
+  }
+  auto error = length == 0 ? LexError::INVALID_UTF8
+                           : LexError::UNEXPECTED_CHARACTER;
+  length = std::max<size_t>(length, 1);
+  Token tok(TokenType::ILLEGAL, input_.substr(position_, length),
+            static_cast<int64_t>(error));
+  jumpTo(position_ + length);
+  return tok;
+}
+
 void Lexer::skipWhitespace() {
-  while (std::isspace(ch_)) {
-    readChar();
+  if (charClass(ch_) == CharClass::WHITESPACE) {
+    jumpTo(scan::skipWhitespace(input_, position_));
   }
 }
 
-std::string Lexer::readNumber() {
-  int start = position_;
-  while (std::isdigit(ch_)) {
+// Integer literals are decimal, 0x hexadecimal or 0b binary, with '_'
+// allowed between digits, and must fit in an int64_t. The whole run of
+// digit-like characters becomes one token so a bad literal is reported as
+// a unit rather than split into odd tokens.
+lexer::Token Lexer::readNumber() {
+  size_t start = position_;
+  int base = 10;
+  if (ch_ == '0' && (peekChar() | 0x20) == 'x') {
+    base = 16;
+  } else if (ch_ == '0' && (peekChar() | 0x20) == 'b') {
+    base = 2;
+  }
+  if (base != 10) {
+    readChar();
     readChar();
   }
-  return input_.substr(start, position_ - start);
+  size_t digits = position_;
+  bool separated = false;
+  while (true) {
+    jumpTo(scan::skipDigits(input_, position_));
+    if (ch_ == '_') {
+      separated = true;
+      readChar();
+    } else if (base == 16 && static_cast<unsigned char>((ch_ | 0x20) - 'a') <
+                                 6) {
+      readChar();
+    } else {
+      break;
+    }
+  }
+  auto literal = input_.substr(start, position_ - start);
+  auto body = input_.substr(digits, position_ - digits);
+
+  int64_t value = 0;
+  auto error = decodeInteger(body, base, separated, value);
+  if (error) {
+    return Token(TokenType::ILLEGAL, literal, static_cast<int64_t>(*error));
+  }
+  return Token(TokenType::INT, literal, value);
 }
 
-std::string Lexer::readString() {
-  int start = position_ + 1;
-  do {
-    readChar();
-  } while (ch_ != '"' && ch_ != '\0');
+std::string_view Lexer::readString() {
+  size_t start = position_ + 1;
+  jumpTo(scan::skipStringBody(input_, start));
   return input_.substr(start, position_ - start);
 }
 
+Symbol Lexer::symbol(std::string_view name) {
+  auto found = symbols_.find(name);
+  if (found != symbols_.end()) {
+    return found->second;
+  }
+  auto interned = intern(name);
+  symbols_.emplace(name, interned);
+  return interned;
+}
+
 char Lexer::peekChar() {
   if (read_position_ >= input_.length()) {
     return '\0';
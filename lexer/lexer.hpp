@@ -1,26 +1,45 @@
 #pragma once
+#include "source.hpp"
+#include "symbol.hpp"
 #include "token.hpp"
+#include "token_stream.hpp"
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace monkey {
 namespace lexer {
 class Lexer {
 public:
-  Lexer(const std::string &input);
+  Lexer(std::string input);
+  explicit Lexer(SourcePtr source);
+  // Lexes only source[begin, end); literals still point into the source.
+  Lexer(SourcePtr source, size_t begin, size_t end);
   lexer::Token nextToken();
+  // Lexes the rest of the input, EOFILE included, in one batch.
+  TokenStream tokenizeAll();
+  const SourcePtr &source() const { return source_; }
 
 private:
-  std::string input_;
-  int position_;
-  int read_position_;
+  SourcePtr source_;
+  std::string_view input_;
+  size_t position_;
+  size_t read_position_;
   char ch_;
   void readChar();
-  std::string readIdentifier();
-  std::string readNumber();
-  std::string readString();
+  void jumpTo(size_t position);
+  std::string_view readIdentifier();
+  lexer::Token readNumber();
+  lexer::Token readNonAscii();
+  std::string_view readString();
   void skipWhitespace();
   char peekChar();
+  Symbol symbol(std::string_view name);
+
+  // Names this lexer has interned, keyed by views into the source, so the
+  // shared table is only locked once per distinct name.
+  std::unordered_map<std::string_view, Symbol> symbols_;
 };
 } // namespace lexer
 } // namespace monkey
@@ -0,0 +1,88 @@
+#include "parallel_lexer.hpp"
+#include "char_class.hpp"
+#include "lexer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace monkey::lexer {
+
+namespace {
+template <typename Fn> void runOnThreads(size_t count, Fn fn) {
+  std::vector<std::thread> workers;
+  workers.reserve(count - 1);
+  for (size_t i = 1; i < count; i++) {
+    workers.emplace_back(fn, i);
+  }
+  fn(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// First whitespace byte at or after pos that is outside a string literal,
+// given whether pos itself starts inside one; text.size() if there is none.
+size_t safeBoundary(std::string_view text, size_t pos, bool inString) {
+  for (; pos < text.size(); pos++) {
+    char ch = text[pos];
+    if (ch == '"') {
+      inString = !inString;
+    } else if (!inString && charClass(ch) == CharClass::WHITESPACE) {
+      return pos;
+    }
+  }
+  return text.size();
+}
+} // namespace
+
+TokenStream tokenizeParallel(SourcePtr source, unsigned threads,
+                             size_t minChunkBytes) {
+  auto text = source->text();
+  size_t chunks = std::max<size_t>(1, threads);
+  chunks = std::min(chunks, text.size() / std::max<size_t>(1, minChunkBytes));
+  if (chunks <= 1 || std::memchr(text.data(), '\0', text.size()) != nullptr) {
+    return Lexer(std::move(source)).tokenizeAll();
+  }
+
+  std::vector<size_t> nominal(chunks + 1);
+  for (size_t i = 0; i <= chunks; i++) {
+    nominal[i] = text.size() * i / chunks;
+  }
+  std::vector<size_t> quotes(chunks);
+  runOnThreads(chunks, [&](size_t i) {
+    quotes[i] = std::count(text.begin() + nominal[i],
+                           text.begin() + nominal[i + 1], '"');
+  });
+
+  std::vector<size_t> bounds = {0};
+  size_t quotesBefore = 0;
+  for (size_t i = 1; i < chunks; i++) {
+    quotesBefore += quotes[i - 1];
+    auto bound = safeBoundary(text, nominal[i], quotesBefore % 2 == 1);
+    if (bound > bounds.back() && bound < text.size()) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(text.size());
+
+  std::vector<TokenStream> parts(bounds.size() - 1);
+  runOnThreads(parts.size(), [&](size_t i) {
+    parts[i] = Lexer(source, bounds[i], bounds[i + 1]).tokenizeAll();
+  });
+
+  TokenStream tokens(std::move(source));
+  size_t total = 0;
+  for (auto &part : parts) {
+    total += part.size();
+  }
+  tokens.reserve(total);
+  for (size_t i = 0; i < parts.size(); i++) {
+    // Every part ends with EOFILE; only the last one is real.
+    bool last = i + 1 == parts.size();
+    tokens.append(parts[i], last ? parts[i].size() : parts[i].size() - 1);
+  }
+  return tokens;
+}
+
+} // namespace monkey::lexer
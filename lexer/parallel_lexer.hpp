@@ -0,0 +1,21 @@
+#pragma once
+#include "source.hpp"
+#include "token_stream.hpp"
+#include <cstddef>
+
+namespace monkey::lexer {
+
+// Lexes source on up to `threads` threads and returns exactly what
+// Lexer(source).tokenizeAll() would.
+//
+// The text is cut into roughly equal chunks, each boundary moved forward
+// to the next whitespace byte outside a string literal -- the only place no
+// token can span. Whether a byte is inside a string only depends on the
+// parity of the '"' bytes before it, which the workers count first. Chunks
+// are then lexed concurrently and their streams joined in order. Inputs
+// below threads * minChunkBytes, or containing NUL bytes (which end lexing
+// in ways that depend on context), are lexed sequentially.
+TokenStream tokenizeParallel(SourcePtr source, unsigned threads,
+                             size_t minChunkBytes = 64 * 1024);
+
+} // namespace monkey::lexer
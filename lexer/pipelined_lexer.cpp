@@ -0,0 +1,53 @@
+#include "pipelined_lexer.hpp"
+#include "lexer.hpp"
+
+namespace monkey::lexer {
+
+PipelinedLexer::PipelinedLexer(SourcePtr source, size_t capacity,
+                               size_t batch)
+    : source_(std::move(source)), ring_(capacity),
+      buffer_(std::max<size_t>(1, batch)) {
+  batch = std::min(buffer_.size(), ring_.capacity());
+  producer_ = std::thread(&PipelinedLexer::produce, this, batch);
+}
+
+PipelinedLexer::~PipelinedLexer() {
+  ring_.cancel();
+  producer_.join();
+}
+
+void PipelinedLexer::produce(size_t batch) {
+  Lexer lexer(source_);
+  std::vector<Token> pending(batch);
+  size_t count = 0;
+  while (true) {
+    auto tok = lexer.nextToken();
+    pending[count++] = tok;
+    bool done = tok.type == TokenType::EOFILE;
+    if (count == batch || done) {
+      if (!ring_.push(pending.data(), count)) {
+        return;
+      }
+      count = 0;
+    }
+    if (done) {
+      ring_.close();
+      return;
+    }
+  }
+}
+
+lexer::Token PipelinedLexer::nextToken() {
+  if (next_ == filled_) {
+    filled_ = ring_.pop(buffer_.data(), buffer_.size());
+    next_ = 0;
+    if (filled_ == 0) {
+      // The producer finished after EOFILE.
+      return last_;
+    }
+  }
+  last_ = buffer_[next_++];
+  return last_;
+}
+
+} // namespace monkey::lexer
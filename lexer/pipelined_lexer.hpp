@@ -0,0 +1,43 @@
+#pragma once
+#include "source.hpp"
+#include "spsc_ring.hpp"
+#include "token.hpp"
+#include <thread>
+#include <vector>
+
+namespace monkey::lexer {
+
+// Lexes a source on a background thread while the caller consumes tokens,
+// so lexing overlaps with parsing instead of preceding it. The producer
+// lexes batch-sized runs of tokens into a bounded SpscRing and blocks when
+// the consumer falls capacity tokens behind. nextToken() returns exactly
+// the sequence Lexer::nextToken() would, repeating EOFILE at the end.
+// Destroying the object early stops the producer.
+class PipelinedLexer {
+public:
+  static constexpr size_t kDefaultCapacity = 4096;
+  static constexpr size_t kDefaultBatch = 128;
+
+  explicit PipelinedLexer(SourcePtr source,
+                          size_t capacity = kDefaultCapacity,
+                          size_t batch = kDefaultBatch);
+  PipelinedLexer(const PipelinedLexer &) = delete;
+  PipelinedLexer &operator=(const PipelinedLexer &) = delete;
+  ~PipelinedLexer();
+
+  lexer::Token nextToken();
+  const SourcePtr &source() const { return source_; }
+
+private:
+  void produce(size_t batch);
+
+  SourcePtr source_;
+  SpscRing<Token> ring_;
+  std::vector<Token> buffer_;
+  size_t next_ = 0;
+  size_t filled_ = 0;
+  Token last_;
+  std::thread producer_;
+};
+
+} // namespace monkey::lexer
@@ -0,0 +1,262 @@
+#include "scan.hpp"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MONKEY_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace monkey::lexer::scan {
+
+namespace {
+
+struct Whitespace {
+  static bool scalar(unsigned char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+  }
+#ifdef MONKEY_SCAN_X86
+  static __m128i sse2(__m128i v) {
+    auto ctrl = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    auto inCtrl = _mm_cmpeq_epi8(
+        _mm_min_epu8(ctrl, _mm_set1_epi8('\r' - '\t')), ctrl);
+    return _mm_or_si128(inCtrl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+  }
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    auto ctrl = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    auto inCtrl = _mm256_cmpeq_epi8(
+        _mm256_min_epu8(ctrl, _mm256_set1_epi8('\r' - '\t')), ctrl);
+    return _mm256_or_si256(inCtrl,
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+  }
+#endif
+};
+
+struct Alpha {
+  static bool scalar(unsigned char c) {
+    return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a';
+  }
+#ifdef MONKEY_SCAN_X86
+  static __m128i sse2(__m128i v) {
+    auto lower = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                              _mm_set1_epi8('a'));
+    return _mm_cmpeq_epi8(_mm_min_epu8(lower, _mm_set1_epi8('z' - 'a')),
+                          lower);
+  }
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    auto lower = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+                                 _mm256_set1_epi8('a'));
+    return _mm256_cmpeq_epi8(
+        _mm256_min_epu8(lower, _mm256_set1_epi8('z' - 'a')), lower);
+  }
+#endif
+};
+
+struct Digit {
+  static bool scalar(unsigned char c) {
+    return static_cast<unsigned char>(c - '0') <= 9;
+  }
+#ifdef MONKEY_SCAN_X86
+  static __m128i sse2(__m128i v) {
+    auto digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    return _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  }
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    auto digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)),
+                             digit);
+  }
+#endif
+};
+
+struct StringBody {
+  static bool scalar(unsigned char c) { return c != '"' && c != '\0'; }
+#ifdef MONKEY_SCAN_X86
+  static __m128i sse2(__m128i v) {
+    auto stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                             _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return _mm_xor_si128(stop, _mm_set1_epi8(-1));
+  }
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    auto stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return _mm256_xor_si256(stop, _mm256_set1_epi8(-1));
+  }
+#endif
+};
+
+struct Ascii {
+  static bool scalar(unsigned char c) { return c < 0x80; }
+#ifdef MONKEY_SCAN_X86
+  static __m128i sse2(__m128i v) {
+    return _mm_cmpgt_epi8(v, _mm_set1_epi8(-1));
+  }
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    return _mm256_cmpgt_epi8(v, _mm256_set1_epi8(-1));
+  }
+#endif
+};
+
+template <typename Run>
+size_t scanScalar(const char *data, size_t pos, size_t end) {
+  while (pos < end && Run::scalar(static_cast<unsigned char>(data[pos]))) {
+    pos++;
+  }
+  return pos;
+}
+
+#ifdef MONKEY_SCAN_X86
+template <typename Run>
+size_t scanSse2(const char *data, size_t pos, size_t end) {
+  while (pos + 16 <= end) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    unsigned mask = _mm_movemask_epi8(Run::sse2(v));
+    if (mask != 0xFFFF) {
+      return pos + __builtin_ctz(~mask);
+    }
+    pos += 16;
+  }
+  return scanScalar<Run>(data, pos, end);
+}
+
+template <typename Run>
+__attribute__((target("avx2"))) size_t scanAvx2(const char *data, size_t pos,
+                                                size_t end) {
+  while (pos + 32 <= end) {
+    auto v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+    unsigned mask = _mm256_movemask_epi8(Run::avx2(v));
+    if (mask != 0xFFFFFFFF) {
+      return pos + __builtin_ctz(~mask);
+    }
+    pos += 32;
+  }
+  return scanSse2<Run>(data, pos, end);
+}
+#endif
+
+using ScanFn = size_t (*)(const char *, size_t, size_t);
+
+struct ScanTable {
+  Isa isa;
+  ScanFn whitespace;
+  ScanFn alpha;
+  ScanFn digits;
+  ScanFn stringBody;
+  ScanFn ascii;
+};
+
+template <template <typename> typename Impl> constexpr ScanTable table(Isa isa) {
+  return {isa, &Impl<Whitespace>::run, &Impl<Alpha>::run, &Impl<Digit>::run,
+          &Impl<StringBody>::run, &Impl<Ascii>::run};
+}
+
+template <typename Run> struct ScalarImpl {
+  static size_t run(const char *d, size_t p, size_t e) {
+    return scanScalar<Run>(d, p, e);
+  }
+};
+constexpr ScanTable scalarTable = table<ScalarImpl>(Isa::SCALAR);
+
+#ifdef MONKEY_SCAN_X86
+template <typename Run> struct Sse2Impl {
+  static size_t run(const char *d, size_t p, size_t e) {
+    return scanSse2<Run>(d, p, e);
+  }
+};
+template <typename Run> struct Avx2Impl {
+  static size_t run(const char *d, size_t p, size_t e) {
+    return scanAvx2<Run>(d, p, e);
+  }
+};
+constexpr ScanTable sse2Table = table<Sse2Impl>(Isa::SSE2);
+constexpr ScanTable avx2Table = table<Avx2Impl>(Isa::AVX2);
+#endif
+
+const ScanTable *tableFor(Isa isa) {
+#ifdef MONKEY_SCAN_X86
+  switch (isa) {
+  case Isa::AVX2:
+    return &avx2Table;
+  case Isa::SSE2:
+    return &sse2Table;
+  case Isa::SCALAR:
+    break;
+  }
+#endif
+  return &scalarTable;
+}
+
+Isa detectIsa() {
+#ifdef MONKEY_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Isa::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return Isa::SSE2;
+  }
+#endif
+  return Isa::SCALAR;
+}
+
+// The implementation in use. Resolved on first use rather than by a
+// dynamic initializer, so lexers run from other static initializers see
+// it too; atomic because setIsa may switch it while other threads scan.
+// All tables are constants, so relaxed ordering is enough.
+std::atomic<const ScanTable *> &activeTable() {
+  static std::atomic<const ScanTable *> table{tableFor(detectIsa())};
+  return table;
+}
+
+const ScanTable *active() {
+  return activeTable().load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+size_t skipWhitespace(std::string_view text, size_t pos) {
+  return active()->whitespace(text.data(), pos, text.size());
+}
+
+size_t skipAlpha(std::string_view text, size_t pos) {
+  return active()->alpha(text.data(), pos, text.size());
+}
+
+size_t skipDigits(std::string_view text, size_t pos) {
+  return active()->digits(text.data(), pos, text.size());
+}
+
+size_t skipStringBody(std::string_view text, size_t pos) {
+  return active()->stringBody(text.data(), pos, text.size());
+}
+
+size_t skipAscii(std::string_view text, size_t pos) {
+  return active()->ascii(text.data(), pos, text.size());
+}
+
+Isa activeIsa() { return active()->isa; }
+
+Isa bestSupportedIsa() { return detectIsa(); }
+
+Isa setIsa(Isa isa) {
+  if (static_cast<int>(isa) > static_cast<int>(bestSupportedIsa())) {
+    isa = bestSupportedIsa();
+  }
+  auto table = tableFor(isa);
+  activeTable().store(table, std::memory_order_relaxed);
+  return table->isa;
+}
+
+const char *to_string(Isa isa) {
+  switch (isa) {
+  case Isa::SCALAR:
+    return "scalar";
+  case Isa::SSE2:
+    return "sse2";
+  case Isa::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+} // namespace monkey::lexer::scan
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// Run scanners used by the Lexer. Each returns the index of the first byte
+// at or after pos that does not continue the run (text.size() if the run
+// reaches the end). Runs are checked 16 or 32 bytes at a time when the CPU
+// supports SSE2/AVX2; the implementation is picked on first use.
+namespace monkey::lexer::scan {
+
+enum class Isa { SCALAR, SSE2, AVX2 };
+
+// ' ', '\t', '\n', '\v', '\f', '\r' -- the "C" locale std::isspace set.
+size_t skipWhitespace(std::string_view text, size_t pos);
+// ASCII letters.
+size_t skipAlpha(std::string_view text, size_t pos);
+// ASCII decimal digits.
+size_t skipDigits(std::string_view text, size_t pos);
+// Everything up to the closing '"' or a NUL byte.
+size_t skipStringBody(std::string_view text, size_t pos);
+// Bytes below 0x80.
+size_t skipAscii(std::string_view text, size_t pos);
+
+Isa activeIsa();
+Isa bestSupportedIsa();
+// Selects an implementation, clamped to what the CPU supports; returns the
+// one actually in use. Meant for benchmarks and tests.
+Isa setIsa(Isa isa);
+
+const char *to_string(Isa isa);
+
+} // namespace monkey::lexer::scan
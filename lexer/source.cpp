@@ -0,0 +1,97 @@
+#include "source.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+namespace monkey::lexer {
+
+Source::Source(std::string text) : owned_(std::move(text)), text_(owned_) {}
+
+Source::Source(void *mapping, size_t length)
+    : mapping_(mapping), mappingLength_(length),
+      text_(static_cast<const char *>(mapping), length) {}
+
+Source::Source(SourcePtr parent, std::string_view text)
+    : parent_(std::move(parent)), text_(text) {}
+
+Source::~Source() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mappingLength_);
+  }
+}
+
+SourcePtr Source::mapFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    auto err = errno;
+    close(fd);
+    throw std::system_error(err, std::generic_category(), path);
+  }
+  auto length = static_cast<size_t>(st.st_size);
+  if (length == 0) {
+    // mmap rejects empty mappings; an empty script needs no backing store.
+    close(fd);
+    return makeSource("");
+  }
+  void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  auto err = errno;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::system_error(err, std::generic_category(), path);
+  }
+  madvise(mapping, length, MADV_SEQUENTIAL);
+  return SourcePtr(new Source(mapping, length));
+}
+
+SourcePtr Source::slice(SourcePtr parent, size_t offset, size_t length) {
+  auto text = parent->text();
+  if (offset > text.size() || length > text.size() - offset) {
+    throw std::out_of_range("slice is past the end of the source");
+  }
+  auto view = text.substr(offset, length);
+  return SourcePtr(new Source(std::move(parent), view));
+}
+
+Location Source::locate(size_t offset) const {
+  if (offset > text_.size()) {
+    throw std::out_of_range("offset " + std::to_string(offset) +
+                            " is past the end of the source");
+  }
+  std::call_once(linesBuilt_, [this] {
+    lineStarts_.push_back(0);
+    auto begin = text_.data(), end = begin + text_.size();
+    const char *p = begin;
+    while ((p = static_cast<const char *>(std::memchr(p, '\n', end - p)))) {
+      ++p;
+      lineStarts_.push_back(p - begin);
+    }
+  });
+  auto next = std::upper_bound(lineStarts_.begin(), lineStarts_.end(), offset);
+  auto line = static_cast<size_t>(next - lineStarts_.begin());
+  return {static_cast<uint32_t>(line),
+          static_cast<uint32_t>(offset - lineStarts_[line - 1] + 1)};
+}
+
+Location Source::locate(std::string_view span) const {
+  if (span.data() < text_.data() ||
+      span.data() + span.size() > text_.data() + text_.size()) {
+    throw std::out_of_range("span does not point into the source");
+  }
+  return locate(static_cast<size_t>(span.data() - text_.data()));
+}
+
+SourcePtr makeSource(std::string text) {
+  return std::make_shared<const Source>(std::move(text));
+}
+
+} // namespace monkey::lexer
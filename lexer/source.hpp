@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace monkey::lexer {
+
+class Source;
+using SourcePtr = std::shared_ptr<const Source>;
+
+// 1-based; the column counts bytes.
+struct Location {
+  uint32_t line;
+  uint32_t column;
+};
+
+// Owns the text of one script. Tokens and AST nodes hold views into it, so
+// the buffer is shared rather than copied and must outlive everything that
+// was lexed from it. The text is either an in-memory string or a read-only
+// mapping of a script file.
+class Source {
+public:
+  explicit Source(std::string text);
+  Source(const Source &) = delete;
+  Source &operator=(const Source &) = delete;
+  ~Source();
+
+  // Maps the file at path read-only; throws std::system_error on failure.
+  static SourcePtr mapFile(const std::string &path);
+  // The length bytes of parent's text starting at offset, sharing (and
+  // keeping alive) parent's buffer; e.g. a script embedded in a mapped
+  // compiled file. Throws std::out_of_range if the range does not fit.
+  static SourcePtr slice(SourcePtr parent, size_t offset, size_t length);
+
+  std::string_view text() const { return text_; }
+  size_t size() const { return text_.size(); }
+  bool isMapped() const {
+    return mapping_ != nullptr || (parent_ != nullptr && parent_->isMapped());
+  }
+
+  // Where the byte at offset sits. The table of line starts is built on
+  // first use, so sources that never report a position do not pay for it.
+  // Throws std::out_of_range past the end of the text.
+  Location locate(size_t offset) const;
+  // Same, for a view into text().
+  Location locate(std::string_view span) const;
+
+private:
+  Source(void *mapping, size_t length);
+  Source(SourcePtr parent, std::string_view text);
+
+  std::string owned_;
+  SourcePtr parent_;
+  void *mapping_ = nullptr;
+  size_t mappingLength_ = 0;
+  std::string_view text_;
+  mutable std::once_flag linesBuilt_;
+  mutable std::vector<size_t> lineStarts_;
+};
+
+SourcePtr makeSource(std::string text);
+
+} // namespace monkey::lexer
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace monkey::lexer {
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. Items are copied in and out in batches: a batch costs one
+// release store to publish, however many items it holds. A full ring
+// blocks the producer and an empty one blocks the consumer, spinning
+// briefly and then sleeping on the index with std::atomic::wait.
+//
+// Either side can end the exchange: close() from the producer lets the
+// consumer drain what is left, cancel() from the consumer makes pending and
+// future pushes fail. Both are folded into the indexes as a flag bit so a
+// sleeping peer always wakes up.
+template <typename T> class SpscRing {
+public:
+  // capacity is rounded up to a power of two.
+  explicit SpscRing(size_t capacity)
+      : capacity_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+        mask_(capacity_ - 1), slots_(std::make_unique<T[]>(capacity_)) {}
+
+  // Producer side. Copies all count items, blocking while the ring is full;
+  // returns false if the consumer cancelled.
+  bool push(const T *items, size_t count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    while (count > 0) {
+      size_t free = capacity_ - (tail - cachedHead_);
+      if (free == 0) {
+        if (!waitFor(head_, cachedHead_, [&](size_t head) {
+              return tail - head < capacity_;
+            })) {
+          return false;
+        }
+        continue;
+      }
+      size_t n = std::min(free, count);
+      for (size_t i = 0; i < n; i++) {
+        slots_[(tail + i) & mask_] = items[i];
+      }
+      tail += n;
+      items += n;
+      count -= n;
+      tail_.store(tail, std::memory_order_release);
+      tail_.notify_one();
+    }
+    return (head_.load(std::memory_order_relaxed) & kDone) == 0;
+  }
+
+  // Producer side; no more items will follow.
+  void close() {
+    tail_.fetch_or(kDone, std::memory_order_release);
+    tail_.notify_one();
+  }
+
+  // Consumer side. Moves up to max items into out, blocking while the ring
+  // is empty; returns 0 only once the producer closed and all items were
+  // taken.
+  size_t pop(T *out, size_t max) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (cachedTail_ == head &&
+        !waitFor(tail_, cachedTail_, [&](size_t tail) { return tail != head; })) {
+      return 0;
+    }
+    size_t n = std::min(cachedTail_ - head, max);
+    for (size_t i = 0; i < n; i++) {
+      out[i] = std::move(slots_[(head + i) & mask_]);
+    }
+    head_.store(head + n, std::memory_order_release);
+    head_.notify_one();
+    return n;
+  }
+
+  // Consumer side; wakes and fails any blocked or later push.
+  void cancel() {
+    head_.fetch_or(kDone, std::memory_order_release);
+    head_.notify_one();
+  }
+
+  size_t capacity() const { return capacity_; }
+
+private:
+  static constexpr size_t kDone = size_t(1) << (sizeof(size_t) * 8 - 1);
+  static constexpr int kSpins = 64;
+
+  // Waits until ready(index) holds for the peer's index, refreshing cached
+  // with its value. Returns false if the peer finished before that.
+  template <typename Ready>
+  static bool waitFor(const std::atomic<size_t> &index, size_t &cached,
+                      Ready ready) {
+    for (int spin = 0;; spin++) {
+      size_t seen = index.load(std::memory_order_acquire);
+      cached = seen & ~kDone;
+      if (ready(cached)) {
+        return true;
+      }
+      if (seen & kDone) {
+        return false;
+      }
+      if (spin >= kSpins) {
+        index.wait(seen, std::memory_order_acquire);
+      }
+    }
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t cachedTail_ = 0; // consumer's view of tail_
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t cachedHead_ = 0; // producer's view of head_
+};
+
+} // namespace monkey::lexer
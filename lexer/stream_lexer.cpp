@@ -0,0 +1,97 @@
+#include "stream_lexer.hpp"
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <unistd.h>
+
+namespace monkey::lexer {
+
+namespace {
+bool isSpace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' ||
+         ch == '\f';
+}
+} // namespace
+
+StreamLexer::StreamLexer(int fd, size_t chunkSize)
+    : fd_(fd), chunkSize_(chunkSize == 0 ? kDefaultChunkSize : chunkSize),
+      eof_(false) {
+  loadWindow();
+}
+
+lexer::Token StreamLexer::nextToken() {
+  // The window that produced the last returned token stays alive until the
+  // following call, however many windows this one has to step over.
+  previous_ = window_;
+  while (true) {
+    auto tok = lexer_->nextToken();
+    if (tok.type != TokenType::EOFILE || !loadWindow()) {
+      return tok;
+    }
+  }
+}
+
+bool StreamLexer::readChunk() {
+  auto used = pending_.size();
+  pending_.resize(used + chunkSize_);
+  ssize_t n;
+  do {
+    n = read(fd_, pending_.data() + used, chunkSize_);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    pending_.resize(used);
+    throw std::system_error(errno, std::generic_category(), "read");
+  }
+  pending_.resize(used + n);
+  if (auto nul = std::memchr(pending_.data() + used, '\0', n)) {
+    pending_.resize(static_cast<const char *>(nul) - pending_.data());
+    eof_ = true;
+  }
+  if (n == 0) {
+    eof_ = true;
+  }
+  return n > 0;
+}
+
+// Moves the next lexable window out of pending_; returns false once the
+// input is exhausted.
+bool StreamLexer::loadWindow() {
+  if (eof_ && pending_.empty()) {
+    if (!lexer_) {
+      window_ = makeSource("");
+      lexer_.emplace(window_);
+    }
+    return false;
+  }
+
+  size_t scanned = 0;
+  size_t cut = 0;
+  bool inString = false;
+  while (true) {
+    for (; scanned < pending_.size(); scanned++) {
+      char ch = pending_[scanned];
+      if (ch == '"') {
+        inString = !inString;
+      } else if (!inString && isSpace(ch)) {
+        cut = scanned;
+      }
+    }
+    if (eof_) {
+      cut = pending_.size();
+      break;
+    }
+    if (cut > 0) {
+      break;
+    }
+    readChunk();
+  }
+
+  auto rest = pending_.substr(cut);
+  pending_.resize(cut);
+  window_ = makeSource(std::move(pending_));
+  pending_ = std::move(rest);
+  lexer_.emplace(window_);
+  return true;
+}
+
+} // namespace monkey::lexer
@@ -0,0 +1,47 @@
+#pragma once
+#include "lexer.hpp"
+#include "source.hpp"
+#include "token.hpp"
+#include <optional>
+#include <string>
+
+namespace monkey::lexer {
+
+// Lexes a script read incrementally from a file descriptor or pipe, so
+// tokens are available before the whole input has arrived and resident
+// memory stays around two chunks plus the longest token.
+//
+// Input is read in chunkSize pieces and cut into windows at whitespace that
+// lies outside a string literal, which no token can span; each window is
+// lexed by an ordinary Lexer, so the token sequence matches lexing the
+// whole text at once. A token's literal stays valid until the second
+// nextToken() call after the one that returned it, which covers the two
+// tokens the parser holds. Input ends at end of file or at the first NUL
+// byte.
+class StreamLexer {
+public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit StreamLexer(int fd, size_t chunkSize = kDefaultChunkSize);
+  lexer::Token nextToken();
+  // The window the token last returned points into. Callers that keep
+  // tokens for longer, such as a Parser building a tree, retain each
+  // window themselves.
+  const SourcePtr &source() const { return window_; }
+
+private:
+  bool loadWindow();
+  bool readChunk();
+
+  int fd_;
+  size_t chunkSize_;
+  bool eof_;
+  // Bytes read but not yet handed to a window; always starts outside a
+  // string literal.
+  std::string pending_;
+  SourcePtr window_;
+  SourcePtr previous_;
+  std::optional<Lexer> lexer_;
+};
+
+} // namespace monkey::lexer
@@ -0,0 +1,57 @@
+#include "symbol.hpp"
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace monkey::lexer {
+
+namespace {
+class SymbolTable {
+public:
+  Symbol intern(std::string_view name) {
+    {
+      std::shared_lock lock(mutex_);
+      auto it = ids_.find(name);
+      if (it != ids_.end()) {
+        return it->second;
+      }
+    }
+    std::unique_lock lock(mutex_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    // The deque never moves its strings, so the map can key on views.
+    std::string_view stored = names_.emplace_back(name);
+    auto symbol = static_cast<Symbol>(names_.size());
+    ids_.emplace(stored, symbol);
+    return symbol;
+  }
+
+  std::string_view name(Symbol symbol) {
+    std::shared_lock lock(mutex_);
+    if (symbol == NO_SYMBOL || symbol > names_.size()) {
+      return {};
+    }
+    return names_[symbol - 1];
+  }
+
+private:
+  std::shared_mutex mutex_;
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, Symbol> ids_;
+};
+
+SymbolTable &symbols() {
+  static SymbolTable table;
+  return table;
+}
+} // namespace
+
+Symbol intern(std::string_view name) { return symbols().intern(name); }
+
+std::string_view symbolName(Symbol symbol) { return symbols().name(symbol); }
+
+} // namespace monkey::lexer
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace monkey::lexer {
+
+// Interned identifier name. Each distinct name is assigned a dense 32-bit id
+// the first time it is seen and keeps it for the life of the process, so
+// scopes can be keyed by integers instead of strings. Ids start at 1; 0 is
+// never a valid symbol.
+using Symbol = uint32_t;
+inline constexpr Symbol NO_SYMBOL = 0;
+
+// Thread-safe. Each Lexer caches what it has interned, so it calls this
+// once per distinct name. Names are never removed: a process that lexes
+// many scripts with different names, e.g. generated ones, keeps every name
+// it has seen, at the size of the name plus a map entry.
+Symbol intern(std::string_view name);
+std::string_view symbolName(Symbol symbol);
+
+} // namespace monkey::lexer
@@ -1,23 +1,65 @@
 #include "token.hpp"
+#include <array>
 #include <ostream>
-#include <unordered_map>
 
 namespace monkey {
 namespace lexer {
 using namespace std::string_view_literals;
-const std::unordered_map<std::string_view, TokenType> keywords = {
-    {"fn"sv, TokenType::FUNCTION},  {"let"sv, TokenType::LET},
-    {"true"sv, TokenType::TRUE},    {"false"sv, TokenType::FALSE},
-    {"if"sv, TokenType::IF},        {"else"sv, TokenType::ELSE},
-    {"return"sv, TokenType::RETURN}};
 
-TokenType LookupIdent(const std::string &ident) {
-  auto it = keywords.find(ident);
-  if (it != keywords.end()) {
-    return it->second;
-  } else {
+namespace {
+struct Keyword {
+  std::string_view word;
+  TokenType type;
+};
+
+constexpr std::array<Keyword, 7> keywords = {{
+    {"fn"sv, TokenType::FUNCTION},
+    {"let"sv, TokenType::LET},
+    {"true"sv, TokenType::TRUE},
+    {"false"sv, TokenType::FALSE},
+    {"if"sv, TokenType::IF},
+    {"else"sv, TokenType::ELSE},
+    {"return"sv, TokenType::RETURN},
+}};
+
+constexpr size_t kMinKeywordLength = 2;
+constexpr size_t kMaxKeywordLength = 6;
+
+// Perfect hash over the keywords above: every keyword gets its own slot, so
+// a lookup is one hash and one string compare.
+constexpr size_t keywordSlot(std::string_view ident) {
+  return (ident.size() + 2 * static_cast<unsigned char>(ident.front()) +
+          static_cast<unsigned char>(ident.back())) &
+         7;
+}
+
+constexpr std::array<Keyword, 8> makeKeywordTable() {
+  std::array<Keyword, 8> table{};
+  for (auto &keyword : keywords) {
+    table[keywordSlot(keyword.word)] = keyword;
+  }
+  return table;
+}
+
+constexpr auto keywordTable = makeKeywordTable();
+
+constexpr bool isPerfect() {
+  for (auto &keyword : keywords) {
+    if (keywordTable[keywordSlot(keyword.word)].word != keyword.word) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(isPerfect(), "keywordSlot must not collide for keywords");
+} // namespace
+
+TokenType LookupIdent(std::string_view ident) {
+  if (ident.size() < kMinKeywordLength || ident.size() > kMaxKeywordLength) {
     return TokenType::IDENT;
   }
+  const auto &slot = keywordTable[keywordSlot(ident)];
+  return slot.word == ident ? slot.type : TokenType::IDENT;
 }
 
 std::string to_string(TokenType tok) {
@@ -2,10 +2,11 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace monkey::lexer {
 
-enum class TokenType {
+enum class TokenType : uint8_t {
 
   // constants
   ILLEGAL,
@@ -44,18 +45,34 @@ enum class TokenType {
   RETURN,
 };
 
+inline constexpr size_t TOKEN_TYPE_COUNT =
+    static_cast<size_t>(TokenType::RETURN) + 1;
+
+// Why the lexer produced an ILLEGAL token; stored in its payload.
+enum class LexError : uint8_t {
+  UNEXPECTED_CHARACTER,
+  MALFORMED_NUMBER,
+  NUMBER_OUT_OF_RANGE,
+  INVALID_UTF8,
+};
+
 struct Token {
   Token() = default;
-  constexpr Token(TokenType type, std::string_view literal)
-      : type(type), literal(literal){};
+  constexpr Token(TokenType type, std::string_view literal,
+                  int64_t payload = 0)
+      : type(type), literal(literal), payload(payload){};
   bool operator==(const Token &rhs) const {
     return type == rhs.type && literal == rhs.literal;
   }
   TokenType type;
-  std::string literal;
+  // View into the lexer's Source (or a static spelling); never owns text.
+  std::string_view literal;
+  // Decoded at lex time: the value of an INT, the LexError of an ILLEGAL,
+  // the interned Symbol of an IDENT.
+  int64_t payload = 0;
 };
 
-TokenType LookupIdent(const std::string &ident);
+TokenType LookupIdent(std::string_view ident);
 
 std::string to_string(TokenType tok);
 std::ostream &operator<<(std::ostream &os, const Token &tok);
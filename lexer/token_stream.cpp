@@ -0,0 +1,99 @@
+#include "token_stream.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace monkey::lexer {
+
+TokenStream::TokenStream(SourcePtr source) : source_(std::move(source)) {
+  if (source_ != nullptr && source_->size() > kMaxSourceSize) {
+    throw std::length_error("source of " + std::to_string(source_->size()) +
+                            " bytes is too large to tokenize");
+  }
+}
+
+void TokenStream::reserve(size_t count) {
+  types_.reserve(count);
+  starts_.reserve(count);
+  lengths_.reserve(count);
+  payloads_.reserve(count);
+}
+
+void TokenStream::push(TokenType type, uint32_t start, uint32_t length,
+                       int64_t payload) {
+  types_.push_back(type);
+  starts_.push_back(start);
+  lengths_.push_back(length);
+  if (type == TokenType::INT) {
+    payloads_.push_back(static_cast<uint32_t>(integers_.size()));
+    integers_.push_back(payload);
+  } else {
+    payloads_.push_back(static_cast<uint32_t>(payload));
+  }
+}
+
+void TokenStream::push(const Token &tok) {
+  auto start = tok.literal.data() - source_->text().data();
+  push(tok.type, static_cast<uint32_t>(start),
+       static_cast<uint32_t>(tok.literal.size()), tok.payload);
+}
+
+void TokenStream::append(const TokenStream &other, size_t count) {
+  append(other, 0, count, 0);
+}
+
+void TokenStream::append(const TokenStream &other, size_t begin, size_t end,
+                         int64_t shift) {
+  auto first = types_.size();
+  types_.insert(types_.end(), other.types_.begin() + begin,
+                other.types_.begin() + end);
+  if (shift == 0) {
+    starts_.insert(starts_.end(), other.starts_.begin() + begin,
+                   other.starts_.begin() + end);
+  } else {
+    auto delta = static_cast<uint32_t>(shift);
+    starts_.resize(first + (end - begin));
+    std::transform(other.starts_.begin() + begin, other.starts_.begin() + end,
+                   starts_.begin() + first,
+                   [delta](uint32_t start) { return start + delta; });
+  }
+  lengths_.insert(lengths_.end(), other.lengths_.begin() + begin,
+                  other.lengths_.begin() + end);
+  payloads_.insert(payloads_.end(), other.payloads_.begin() + begin,
+                   other.payloads_.begin() + end);
+  // Integer literals point into other's side table; copy their values.
+  for (size_t i = first; i < types_.size(); i++) {
+    if (types_[i] == TokenType::INT) {
+      auto value = other.integers_[payloads_[i]];
+      payloads_[i] = static_cast<uint32_t>(integers_.size());
+      integers_.push_back(value);
+    }
+  }
+}
+
+std::string_view TokenStream::literal(size_t i) const {
+  return source_->text().substr(starts_[i], lengths_[i]);
+}
+
+int64_t TokenStream::payload(size_t i) const {
+  return types_[i] == TokenType::INT ? integers_[payloads_[i]] : payloads_[i];
+}
+
+Token TokenStream::token(size_t i) const {
+  if (types_.empty()) {
+    return Token(TokenType::EOFILE, {});
+  }
+  if (i >= types_.size()) {
+    i = types_.size() - 1;
+  }
+  return Token(types_[i], literal(i), payload(i));
+}
+
+size_t TokenStream::memoryUsage() const {
+  return types_.capacity() * sizeof(TokenType) +
+         (starts_.capacity() + lengths_.capacity() + payloads_.capacity()) *
+             sizeof(uint32_t) +
+         integers_.capacity() * sizeof(int64_t);
+}
+
+} // namespace monkey::lexer
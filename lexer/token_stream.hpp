@@ -0,0 +1,63 @@
+#pragma once
+#include "source.hpp"
+#include "token.hpp"
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace monkey::lexer {
+
+// A whole buffer's tokens in structure-of-arrays form, with the literal
+// text left in the shared Source: one byte of type, two 32-bit words of
+// position and a 32-bit payload per token, 13 bytes in all. The payload is
+// an identifier's symbol or an ILLEGAL token's LexError; integer literals,
+// whose values need 64 bits but are few, hold the index of their value in
+// a side table instead. The stream is immutable once built, so one lexing
+// pass can feed any number of parsers, each reading it by index. The last
+// token is always EOFILE.
+class TokenStream {
+public:
+  // Largest source whose offsets fit the 32-bit position columns.
+  static constexpr size_t kMaxSourceSize = std::numeric_limits<uint32_t>::max();
+
+  TokenStream() = default;
+  // Throws std::length_error for a source over kMaxSourceSize.
+  explicit TokenStream(SourcePtr source);
+
+  void reserve(size_t count);
+  void push(TokenType type, uint32_t start, uint32_t length,
+            int64_t payload = 0);
+  void push(const Token &tok);
+  // Appends the first count tokens of other, which must share this
+  // stream's source.
+  void append(const TokenStream &other, size_t count);
+  // Appends tokens [begin, end) of other with their offsets moved by shift,
+  // for reusing tokens of an older version of the same text.
+  void append(const TokenStream &other, size_t begin, size_t end,
+              int64_t shift);
+
+  size_t size() const { return types_.size(); }
+  TokenType type(size_t i) const { return types_[i]; }
+  uint32_t start(size_t i) const { return starts_[i]; }
+  uint32_t length(size_t i) const { return lengths_[i]; }
+  std::string_view literal(size_t i) const;
+  int64_t payload(size_t i) const;
+  // Materialises token i; indexes past the end yield the final EOFILE, or
+  // an empty one if the stream has no tokens.
+  Token token(size_t i) const;
+
+  const SourcePtr &source() const { return source_; }
+  size_t memoryUsage() const;
+
+private:
+  SourcePtr source_;
+  std::vector<TokenType> types_;
+  std::vector<uint32_t> starts_;
+  std::vector<uint32_t> lengths_;
+  std::vector<uint32_t> payloads_;
+  // Values of the integer literals, in token order.
+  std::vector<int64_t> integers_;
+};
+
+} // namespace monkey::lexer
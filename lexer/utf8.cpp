@@ -0,0 +1,88 @@
+#include "utf8.hpp"
+#include "scan.hpp"
+#include "xid_tables.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace monkey::lexer::utf8 {
+
+namespace {
+template <size_t N>
+bool inRanges(const CodePointRange (&ranges)[N], char32_t codePoint) {
+  auto it = std::upper_bound(
+      std::begin(ranges), std::end(ranges), codePoint,
+      [](char32_t cp, const CodePointRange &r) { return cp < r.first; });
+  return it != std::begin(ranges) && codePoint <= std::prev(it)->last;
+}
+} // namespace
+
+// Well-formed sequences per the Unicode standard, table 3-7.
+size_t decode(std::string_view text, size_t pos, char32_t &codePoint) {
+  auto byte = [&](size_t i) -> unsigned char {
+    return pos + i < text.size() ? static_cast<unsigned char>(text[pos + i])
+                                 : 0;
+  };
+  auto lead = byte(0);
+  if (lead < 0x80) {
+    codePoint = lead;
+    return 1;
+  }
+  size_t length;
+  unsigned char low = 0x80, high = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+    codePoint = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    codePoint = lead & 0x0F;
+    low = lead == 0xE0 ? 0xA0 : 0x80;
+    high = lead == 0xED ? 0x9F : 0xBF;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    codePoint = lead & 0x07;
+    low = lead == 0xF0 ? 0x90 : 0x80;
+    high = lead == 0xF4 ? 0x8F : 0xBF;
+  } else {
+    return 0;
+  }
+  for (size_t i = 1; i < length; i++) {
+    auto next = byte(i);
+    if (next < low || next > high) {
+      return 0;
+    }
+    low = 0x80;
+    high = 0xBF;
+    codePoint = (codePoint << 6) | (next & 0x3F);
+  }
+  return length;
+}
+
+bool isValid(std::string_view text) {
+  size_t pos = 0;
+  while ((pos = scan::skipAscii(text, pos)) < text.size()) {
+    char32_t codePoint;
+    auto length = decode(text, pos, codePoint);
+    if (length == 0) {
+      return false;
+    }
+    pos += length;
+  }
+  return true;
+}
+
+bool isXidStart(char32_t codePoint) {
+  if (codePoint < 0x80) {
+    return (codePoint | 0x20) - 'a' <= 'z' - 'a';
+  }
+  return inRanges(xidStartRanges, codePoint);
+}
+
+bool isXidContinue(char32_t codePoint) {
+  if (codePoint < 0x80) {
+    return (codePoint | 0x20) - 'a' <= 'z' - 'a' || codePoint - '0' <= 9 ||
+           codePoint == '_';
+  }
+  return inRanges(xidContinueRanges, codePoint);
+}
+
+} // namespace monkey::lexer::utf8
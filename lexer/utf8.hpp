@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// UTF-8 decoding and validation for the lexer. Only non-ASCII input ever
+// reaches these; ASCII is handled by the byte tables and run scanners.
+namespace monkey::lexer::utf8 {
+
+// Decodes the code point starting at text[pos] and returns its length in
+// bytes, or 0 if the sequence is ill-formed: a stray continuation byte, an
+// overlong form, a surrogate, a value past U+10FFFF or a truncated tail.
+size_t decode(std::string_view text, size_t pos, char32_t &codePoint);
+
+// Whether all of text is well-formed UTF-8. ASCII runs are skipped with the
+// vectorised scanner; only the non-ASCII sequences between them are decoded.
+bool isValid(std::string_view text);
+
+bool isXidStart(char32_t codePoint);
+bool isXidContinue(char32_t codePoint);
+
+} // namespace monkey::lexer::utf8
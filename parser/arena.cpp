@@ -0,0 +1,28 @@
+#include "arena.hpp"
+#include <cstring>
+
+namespace monkey::parser::ast {
+
+Arena::Arena(size_t initialBytes)
+    : upstream_(reserved_), resource_(initialBytes, &upstream_) {}
+
+void Arena::retain(std::shared_ptr<const void> owner) {
+  retained_.push_back(std::move(owner));
+}
+
+std::string_view Arena::copy(std::string_view text) {
+  auto *memory = static_cast<char *>(resource_.allocate(text.size(), 1));
+  std::memcpy(memory, text.data(), text.size());
+  return {memory, text.size()};
+}
+
+void *Arena::Upstream::do_allocate(size_t bytes, size_t alignment) {
+  reserved_ += bytes;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void Arena::Upstream::do_deallocate(void *p, size_t bytes, size_t alignment) {
+  std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+} // namespace monkey::parser::ast
@@ -0,0 +1,72 @@
+#pragma once
+#include "ast.hpp"
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace monkey::parser::ast {
+
+// Bump allocator for the nodes of one parse. Nodes and the vectors inside
+// them are carved out of large blocks, so a statement's nodes sit next to
+// each other and the whole tree is released at once when the last owner of
+// the arena goes away. Arena nodes are never destroyed one by one; they may
+// only own memory from the same arena. Not thread-safe.
+class Arena {
+public:
+  explicit Arena(size_t initialBytes = 4096);
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  template <typename T, typename... Args> Ptr<T> make(Args &&...args) {
+    void *memory = resource_.allocate(sizeof(T), alignof(T));
+    T *node;
+    if constexpr (std::is_constructible_v<T, Args..., Allocator>) {
+      node = new (memory) T(std::forward<Args>(args)..., allocator());
+    } else {
+      node = new (memory) T(std::forward<Args>(args)...);
+    }
+    node->inArena = true;
+    nodes_++;
+    nodeBytes_ += sizeof(T);
+    return Ptr<T>(node);
+  }
+
+  Allocator allocator() { return Allocator(&resource_); }
+  // Copies text into the arena, for nodes whose text is not in the source.
+  std::string_view copy(std::string_view text);
+  // Keeps owner alive as long as the arena, e.g. the source text that the
+  // nodes' tokens point into.
+  void retain(std::shared_ptr<const void> owner);
+  // Bytes requested from the system so far.
+  size_t reserved() const { return reserved_; }
+  // Nodes made so far and the bytes of the node objects themselves; the
+  // rest of reserved() is child vectors and unused block space.
+  size_t nodes() const { return nodes_; }
+  size_t nodeBytes() const { return nodeBytes_; }
+
+private:
+  // Counts what the monotonic resource asks its upstream for.
+  class Upstream : public std::pmr::memory_resource {
+  public:
+    explicit Upstream(size_t &reserved) : reserved_(reserved) {}
+
+  private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+    size_t &reserved_;
+  };
+
+  size_t reserved_ = 0;
+  size_t nodes_ = 0;
+  size_t nodeBytes_ = 0;
+  Upstream upstream_;
+  std::pmr::monotonic_buffer_resource resource_;
+  std::vector<std::shared_ptr<const void>> retained_;
+};
+
+} // namespace monkey::parser::ast
@@ -1,7 +1,60 @@
 #include "ast.hpp"
+#include "arena.hpp"
+#include <stdexcept>
 
 namespace monkey::parser::ast {
 
+Op toOp(lexer::TokenType type) {
+  switch (type) {
+  case lexer::TokenType::PLUS:
+    return Op::PLUS;
+  case lexer::TokenType::MINUS:
+    return Op::MINUS;
+  case lexer::TokenType::ASTERISK:
+    return Op::ASTERISK;
+  case lexer::TokenType::SLASH:
+    return Op::SLASH;
+  case lexer::TokenType::LT:
+    return Op::LT;
+  case lexer::TokenType::GT:
+    return Op::GT;
+  case lexer::TokenType::EQ:
+    return Op::EQ;
+  case lexer::TokenType::NOT_EQ:
+    return Op::NOT_EQ;
+  case lexer::TokenType::BANG:
+    return Op::BANG;
+  default:
+    return Op::UNKNOWN;
+  }
+}
+
+std::string_view to_string(Op op) {
+  switch (op) {
+  case Op::PLUS:
+    return "+";
+  case Op::MINUS:
+    return "-";
+  case Op::ASTERISK:
+    return "*";
+  case Op::SLASH:
+    return "/";
+  case Op::LT:
+    return "<";
+  case Op::GT:
+    return ">";
+  case Op::EQ:
+    return "==";
+  case Op::NOT_EQ:
+    return "!=";
+  case Op::BANG:
+    return "!";
+  case Op::UNKNOWN:
+    break;
+  }
+  return "?";
+}
+
 std::string Program::TokenLiteral() const {
   if (statements.empty()) {
     return "";
@@ -9,53 +62,84 @@ std::string Program::TokenLiteral() const {
   return statements[0]->TokenLiteral();
 }
 
-std::string Statement::TokenLiteral() const { return token.literal; }
+std::string Statement::TokenLiteral() const { return std::string(literal()); }
+
+std::string Expression::TokenLiteral() const {
+  return std::string(literal());
+}
+
+lexer::Location Program::locate(const Node &node) const {
+  if (source == nullptr) {
+    throw std::out_of_range("program has no source");
+  }
+  return source->locate(node.literal());
+}
 
-std::string Expression::TokenLiteral() const { return token.literal; }
+Node::Node(uint8_t tag, const lexer::Token &tok)
+    : text_(tok.literal.data()),
+      length_(static_cast<uint32_t>(tok.literal.size())), tag_(tag),
+      tokenType_(tok.type) {}
 
-Statement::Statement(lexer::Token tok) : token(tok) {}
+Program::Program(std::shared_ptr<Arena> arena)
+    : arena(std::move(arena)), statements(this->arena->allocator()) {}
 
-Expression::Expression(lexer::Token tok) : token(tok) {}
+Statement::Statement(lexer::Token tok, StatementType type)
+    : Node(static_cast<uint8_t>(type), tok) {}
 
-LetStatement::LetStatement(lexer::Token tok) : Statement(tok) {}
+Expression::Expression(lexer::Token tok, ExpressionType type)
+    : Node(static_cast<uint8_t>(type), tok) {}
 
+LetStatement::LetStatement(lexer::Token tok)
+    : Statement(tok, StatementType::LET) {}
+
+// Lexed identifiers arrive already interned; hand-built tokens do not.
 Identifier::Identifier(lexer::Token tok)
-    : Expression(tok), value(tok.literal) {}
+    : Expression(tok, ExpressionType::IDENTIFIER),
+      symbol(tok.payload != 0 ? static_cast<lexer::Symbol>(tok.payload)
+                              : lexer::intern(tok.literal)) {}
 
-ReturnStatement::ReturnStatement(lexer::Token tok) : Statement(tok) {}
+ReturnStatement::ReturnStatement(lexer::Token tok)
+    : Statement(tok, StatementType::RETURN) {}
 
 ExpressionStatement::ExpressionStatement(lexer::Token tok)
-    : Statement(tok), expression(nullptr) {}
+    : Statement(tok, StatementType::EXPRESSION), expression(nullptr) {}
 
-IntegerLiteral::IntegerLiteral(lexer::Token tok) : Expression(tok) {}
+IntegerLiteral::IntegerLiteral(lexer::Token tok)
+    : Expression(tok, ExpressionType::INTEGER) {}
 
 PrefixExpression::PrefixExpression(lexer::Token tok)
-    : Expression(tok), op(tok.literal), right(nullptr) {}
+    : Expression(tok, ExpressionType::PREFIX), op(toOp(tok.type)),
+      right(nullptr) {}
 
 InfixExpression::InfixExpression(lexer::Token tok)
-    : Expression(tok), left(nullptr), op(tok.literal), right(nullptr) {}
+    : Expression(tok, ExpressionType::INFIX), op(toOp(tok.type)),
+      left(nullptr), right(nullptr) {}
 
-Boolean::Boolean(lexer::Token tok, bool val) : Expression(tok), value(val) {}
+Boolean::Boolean(lexer::Token tok, bool val)
+    : Expression(tok, ExpressionType::BOOLEAN), value(val) {}
 
 IfExpression::IfExpression(lexer::Token tok)
-    : Expression(tok), condition(nullptr), consequence(nullptr),
-      alternative(nullptr) {}
+    : Expression(tok, ExpressionType::IF), condition(nullptr),
+      consequence(nullptr), alternative(nullptr) {}
 
-BlockStatement::BlockStatement(lexer::Token tok) : Statement(tok) {}
+BlockStatement::BlockStatement(lexer::Token tok, Allocator alloc)
+    : Statement(tok, StatementType::BLOCK), statements(alloc) {}
 
-FunctionLiteral::FunctionLiteral(lexer::Token tok)
-    : Expression(tok), body{nullptr} {}
+FunctionLiteral::FunctionLiteral(lexer::Token tok, Allocator alloc)
+    : Expression(tok, ExpressionType::FUNCTION), parameters(alloc),
+      body{nullptr}, slots(alloc) {}
 
-CallExpression::CallExpression(lexer::Token tok)
-    : Expression(tok), function{nullptr}, arguments{} {}
+CallExpression::CallExpression(lexer::Token tok, Allocator alloc)
+    : Expression(tok, ExpressionType::CALL), function{nullptr},
+      arguments(alloc) {}
 
 StringLiteral::StringLiteral(lexer::Token tok)
-    : Expression(tok), value(tok.literal) {}
+    : Expression(tok, ExpressionType::STRING) {}
 
-ArrayLiteral::ArrayLiteral(lexer::Token tok)
-    : Expression(tok), elements{} {}
+ArrayLiteral::ArrayLiteral(lexer::Token tok, Allocator alloc)
+    : Expression(tok, ExpressionType::ARRAY), elements(alloc) {}
 
-std::string Expression::to_string() const { return token.literal; }
+std::string Expression::to_string() const { return std::string(literal()); }
 
 std::string Program::to_string() const {
   std::string out;
@@ -65,9 +149,9 @@ std::string Program::to_string() const {
   return out;
 }
 
-std::string Identifier::to_string() const { return value; }
+std::string Identifier::to_string() const { return std::string(literal()); }
 std::string LetStatement::to_string() const {
-  std::string out = token.literal + " " + name->to_string() + " = ";
+  std::string out = TokenLiteral() + " " + name->to_string() + " = ";
   if (value) {
     out += value->to_string();
   }
@@ -76,7 +160,7 @@ std::string LetStatement::to_string() const {
 }
 
 std::string ReturnStatement::to_string() const {
-  std::string out = token.literal + " ";
+  std::string out = TokenLiteral() + " ";
   if (returnValue) {
     out += returnValue->to_string();
   }
@@ -92,7 +176,8 @@ std::string ExpressionStatement::to_string() const {
 }
 
 std::string PrefixExpression::to_string() const {
-  std::string out = "(" + op;
+  std::string out = "(";
+  out += literal();
   if (right) {
     out += right->to_string();
   }
@@ -105,7 +190,9 @@ std::string InfixExpression::to_string() const {
   if (left) {
     out += left->to_string();
   }
-  out += " " + op + " ";
+  out += " ";
+  out += literal();
+  out += " ";
   if (right) {
     out += right->to_string();
   }
@@ -134,7 +221,7 @@ std::string BlockStatement::to_string() const {
 }
 
 std::string FunctionLiteral::to_string() const {
-  std::string out = token.literal + "(";
+  std::string out = TokenLiteral() + "(";
   if (parameters.size() > 0) {
     for (const auto &param : parameters) {
       out += param->to_string() + ", ";
@@ -159,7 +246,9 @@ std::string CallExpression::to_string() const {
   return out;
 }
 
-std::string StringLiteral::to_string() const { return value; }
+std::string StringLiteral::to_string() const {
+  return std::string(literal());
+}
 
 std::string ArrayLiteral::to_string() const {
   std::string out = "[";
@@ -1,24 +1,47 @@
 #pragma once
 
+#include "../lexer/source.hpp"
+#include "../lexer/symbol.hpp"
 #include "../lexer/token.hpp"
 #include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 namespace monkey::parser::ast {
 
+class Arena;
+class Node;
 class Identifier;
 class Expression;
-using Parameters = std::vector<std::unique_ptr<Identifier>>;
-using Arguments = std::vector<std::unique_ptr<Expression>>;
+class Statement;
 
-enum class StatementType {
+// Allocator for the vectors inside nodes; parsed nodes get their arena's.
+using Allocator = std::pmr::polymorphic_allocator<std::byte>;
+
+// Deletes nodes built on the heap (in tests, say); nodes allocated from an
+// Arena are left alone and released together with it.
+struct NodeDeleter {
+  NodeDeleter() = default;
+  template <typename T> NodeDeleter(std::default_delete<T>) {}
+  void operator()(const Node *node) const;
+};
+
+template <typename T> using Ptr = std::unique_ptr<T, NodeDeleter>;
+
+using Parameters = std::pmr::vector<Ptr<Identifier>>;
+using Arguments = std::pmr::vector<Ptr<Expression>>;
+using Statements = std::pmr::vector<Ptr<Statement>>;
+using Symbols = std::pmr::vector<lexer::Symbol>;
+
+enum class StatementType : uint8_t {
   LET,
   RETURN,
   EXPRESSION,
   BLOCK,
 };
 
-enum class ExpressionType {
+enum class ExpressionType : uint8_t {
   IDENTIFIER,
   INTEGER,
   BOOLEAN,
@@ -31,49 +54,111 @@ enum class ExpressionType {
   ARRAY,
 };
 
+// Operator of a prefix or infix expression, resolved from its token when
+// the node is made so that evaluation can switch on it.
+enum class Op : uint8_t {
+  PLUS,
+  MINUS,
+  ASTERISK,
+  SLASH,
+  LT,
+  GT,
+  EQ,
+  NOT_EQ,
+  BANG,
+  // Any other token; the parser never makes such a node.
+  UNKNOWN,
+};
+
+// Where the binding an identifier names lives, as worked out by
+// resolveScopes (parser/resolver.hpp).
+enum class Binding : uint8_t {
+  // Unknown: the evaluator looks the name up in each environment out from
+  // the current one.
+  DYNAMIC,
+  // A slot of the environment of an enclosing function.
+  LOCAL,
+  // Not bound by any enclosing function: a global or a builtin.
+  GLOBAL,
+};
+
+Op toOp(lexer::TokenType type);
+std::string_view to_string(Op op);
+
 class Node {
 public:
   virtual ~Node() = default;
   virtual std::string to_string() const = 0;
   virtual std::string TokenLiteral() const = 0;
+  // Text of the node's token, a view into the source it was parsed from.
+  std::string_view literal() const { return {text_, length_}; }
+  lexer::TokenType tokenType() const { return tokenType_; }
 
 protected:
   Node() = default;
+  Node(uint8_t tag, const lexer::Token &tok);
+
+  // The token is kept as a pointer and a length rather than a Token copy;
+  // together with the flags below this packs into the word after the
+  // vtable pointer.
+  const char *text_ = nullptr;
+  uint32_t length_ = 0;
+
+public:
+  // Set by Arena::make.
+  bool inArena = false;
+
+protected:
+  // StatementType or ExpressionType, kept inline so dispatching on a node's
+  // kind is a byte load rather than a virtual call.
+  uint8_t tag_ = 0;
+  lexer::TokenType tokenType_ = lexer::TokenType::ILLEGAL;
 };
 
+inline void NodeDeleter::operator()(const Node *node) const {
+  if (node != nullptr && !node->inArena) {
+    delete node;
+  }
+}
+
 class Statement : public Node {
 public:
   virtual ~Statement() = default;
   std::string to_string() const override = 0;
   std::string TokenLiteral() const override;
-  lexer::Token token;
-  constexpr virtual StatementType Type() const = 0;
+  StatementType Type() const { return static_cast<StatementType>(tag_); }
 
 protected:
-  explicit Statement(lexer::Token tok);
+  Statement(lexer::Token tok, StatementType type);
 };
 
-using Statements = std::vector<std::unique_ptr<Statement>>;
-
 class Expression : public Node {
 public:
   virtual ~Expression() = default;
   std::string to_string() const override;
   std::string TokenLiteral() const override;
-  lexer::Token token;
-  constexpr virtual ExpressionType Type() const = 0;
+  ExpressionType Type() const { return static_cast<ExpressionType>(tag_); }
 
 protected:
-  explicit Expression(lexer::Token tok);
+  Expression(lexer::Token tok, ExpressionType type);
 };
 
 class Program : public Node {
 public:
   Program() = default;
+  explicit Program(std::shared_ptr<Arena> arena);
   ~Program() override = default;
   std::string to_string() const override;
   std::string TokenLiteral() const override;
+  // Text the tokens and string values of this program point into.
+  lexer::SourcePtr source;
+  // Storage of the nodes below; also keeps source alive. Null for trees
+  // built by hand.
+  std::shared_ptr<Arena> arena;
   Statements statements;
+
+  // Line and column of a node parsed from source.
+  lexer::Location locate(const Node &node) const;
 };
 
 class Identifier : public Expression {
@@ -81,10 +166,15 @@ public:
   explicit Identifier(lexer::Token tok);
   ~Identifier() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::IDENTIFIER;
-  }
-  std::string value;
+  std::string_view value() const { return literal(); }
+  // Packs into the tail of Node.
+  Binding binding = Binding::DYNAMIC;
+  lexer::Symbol symbol;
+  // Functions out from the innermost one enclosing the identifier to the
+  // one holding the binding (LOCAL) or to the top level (GLOBAL).
+  uint16_t depth = 0;
+  // Index of a LOCAL binding in that function's slots.
+  uint16_t slot = 0;
 };
 
 class LetStatement : public Statement {
@@ -92,11 +182,8 @@ public:
   explicit LetStatement(lexer::Token tok);
   ~LetStatement() override = default;
   std::string to_string() const override;
-  constexpr StatementType Type() const override{
-    return StatementType::LET;
-  }
-  std::unique_ptr<Identifier> name;
-  std::unique_ptr<Expression> value;
+  Ptr<Identifier> name;
+  Ptr<Expression> value;
 };
 
 class ReturnStatement : public Statement {
@@ -104,10 +191,7 @@ public:
   explicit ReturnStatement(lexer::Token tok);
   ~ReturnStatement() override = default;
   std::string to_string() const override;
-  constexpr StatementType Type() const override{
-    return StatementType::RETURN;
-  }
-  std::unique_ptr<Expression> returnValue;
+  Ptr<Expression> returnValue;
 };
 
 class ExpressionStatement : public Statement {
@@ -115,19 +199,13 @@ public:
   explicit ExpressionStatement(lexer::Token tok);
   ~ExpressionStatement() override = default;
   std::string to_string() const override;
-  constexpr StatementType Type() const override{
-    return StatementType::EXPRESSION;
-  }
-  std::unique_ptr<Expression> expression;
+  Ptr<Expression> expression;
 };
 
 class IntegerLiteral : public Expression {
 public:
   explicit IntegerLiteral(lexer::Token tok);
   ~IntegerLiteral() override = default;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::INTEGER;
-  }
   int64_t value;
 };
 
@@ -136,11 +214,8 @@ public:
   explicit PrefixExpression(lexer::Token tok);
   ~PrefixExpression() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::PREFIX;
-  }
-  std::string op;
-  std::unique_ptr<Expression> right;
+  Op op;
+  Ptr<Expression> right;
 };
 
 class InfixExpression : public Expression {
@@ -148,32 +223,23 @@ public:
   explicit InfixExpression(lexer::Token tok);
   ~InfixExpression() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::INFIX;
-  }
-  std::unique_ptr<Expression> left;
-  std::string op;
-  std::unique_ptr<Expression> right;
+  Op op;
+  Ptr<Expression> left;
+  Ptr<Expression> right;
 };
 
 class Boolean : public Expression {
 public:
   Boolean(lexer::Token tok, bool val);
   ~Boolean() override = default;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::BOOLEAN;
-  }
   bool value;
 };
 
 class BlockStatement : public Statement {
 public:
-  explicit BlockStatement(lexer::Token tok);
+  explicit BlockStatement(lexer::Token tok, Allocator alloc = {});
   ~BlockStatement() override = default;
   std::string to_string() const override;
-  constexpr StatementType Type() const override{
-    return StatementType::BLOCK;
-  }
   Statements statements;
 };
 
@@ -182,35 +248,30 @@ public:
   explicit IfExpression(lexer::Token tok);
   ~IfExpression() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::IF;
-  }
-  std::unique_ptr<Expression> condition;
-  std::unique_ptr<BlockStatement> consequence;
-  std::unique_ptr<BlockStatement> alternative;
+  Ptr<Expression> condition;
+  Ptr<BlockStatement> consequence;
+  Ptr<BlockStatement> alternative;
 };
 
 class FunctionLiteral : public Expression {
 public:
-  explicit FunctionLiteral(lexer::Token tok);
+  explicit FunctionLiteral(lexer::Token tok, Allocator alloc = {});
   ~FunctionLiteral() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::FUNCTION;
-  }
   Parameters parameters;
-  std::unique_ptr<BlockStatement> body;
+  Ptr<BlockStatement> body;
+  // Set by resolveScopes: the names of the slots of an environment for
+  // a call, parameters first, then the names bound by `let` in the body.
+  bool resolved = false;
+  Symbols slots;
 };
 
 class CallExpression : public Expression {
 public:
-  explicit CallExpression(lexer::Token tok);
+  explicit CallExpression(lexer::Token tok, Allocator alloc = {});
   ~CallExpression() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::CALL;
-  }
-  std::unique_ptr<Expression> function;
+  Ptr<Expression> function;
   Arguments arguments;
 };
 
@@ -219,20 +280,14 @@ public:
   explicit StringLiteral(lexer::Token tok);
   ~StringLiteral() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::STRING;
-  }
-  std::string value;
+  std::string_view value() const { return literal(); }
 };
 
 class ArrayLiteral : public Expression {
 public:
-  explicit ArrayLiteral(lexer::Token tok);
+  explicit ArrayLiteral(lexer::Token tok, Allocator alloc = {});
   ~ArrayLiteral() override = default;
   std::string to_string() const override;
-  constexpr ExpressionType Type() const override{
-    return ExpressionType::ARRAY;
-  }
   Arguments elements;
 };
 
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ast.hpp"
+
+namespace monkey::parser::ast {
+
+// Calls visit on the child statements and expressions of node, null ones
+// included. A let's name and a function's parameters are not visited.
+template <typename Visit> void forEachChild(Statement &node, Visit visit) {
+  switch (node.Type()) {
+  case StatementType::LET:
+    visit(static_cast<LetStatement &>(node).value.get());
+    break;
+  case StatementType::RETURN:
+    visit(static_cast<ReturnStatement &>(node).returnValue.get());
+    break;
+  case StatementType::EXPRESSION:
+    visit(static_cast<ExpressionStatement &>(node).expression.get());
+    break;
+  case StatementType::BLOCK:
+    for (auto &child : static_cast<BlockStatement &>(node).statements) {
+      visit(child.get());
+    }
+    break;
+  }
+}
+
+template <typename Visit>
+void forEachChild(Expression &node, Visit visit) {
+  switch (node.Type()) {
+  case ExpressionType::PREFIX:
+    visit(static_cast<PrefixExpression &>(node).right.get());
+    break;
+  case ExpressionType::INFIX: {
+    auto &infix = static_cast<InfixExpression &>(node);
+    visit(infix.left.get());
+    visit(infix.right.get());
+    break;
+  }
+  case ExpressionType::IF: {
+    auto &ifExpr = static_cast<IfExpression &>(node);
+    visit(ifExpr.condition.get());
+    visit(static_cast<Statement *>(ifExpr.consequence.get()));
+    visit(static_cast<Statement *>(ifExpr.alternative.get()));
+    break;
+  }
+  case ExpressionType::FUNCTION:
+    visit(static_cast<Statement *>(
+        static_cast<FunctionLiteral &>(node).body.get()));
+    break;
+  case ExpressionType::CALL: {
+    auto &call = static_cast<CallExpression &>(node);
+    visit(call.function.get());
+    for (auto &argument : call.arguments) {
+      visit(argument.get());
+    }
+    break;
+  }
+  case ExpressionType::ARRAY:
+    for (auto &element : static_cast<ArrayLiteral &>(node).elements) {
+      visit(element.get());
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace monkey::parser::ast
@@ -0,0 +1,457 @@
+#include "flat_ast.hpp"
+#include "arena.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace monkey::parser::flat {
+
+namespace {
+
+class Flattener {
+public:
+  explicit Flattener(Tree &tree) : tree_(tree) {}
+
+  Index statement(const ast::Statement *stmt) {
+    if (stmt == nullptr) {
+      return NONE;
+    }
+    switch (stmt->Type()) {
+    case ast::StatementType::LET: {
+      auto let = static_cast<const ast::LetStatement *>(stmt);
+      auto index = add(Tag::LET, *let);
+      auto name = expression(let->name.get());
+      auto value = expression(let->value.get());
+      tree_.nodes[index].a = name;
+      tree_.nodes[index].b = value;
+      return index;
+    }
+    case ast::StatementType::RETURN: {
+      auto ret = static_cast<const ast::ReturnStatement *>(stmt);
+      auto index = add(Tag::RETURN, *ret);
+      auto value = expression(ret->returnValue.get());
+      tree_.nodes[index].a = value;
+      return index;
+    }
+    case ast::StatementType::EXPRESSION: {
+      auto expr = static_cast<const ast::ExpressionStatement *>(stmt);
+      auto index = add(Tag::EXPRESSION, *expr);
+      auto value = expression(expr->expression.get());
+      tree_.nodes[index].a = value;
+      return index;
+    }
+    case ast::StatementType::BLOCK: {
+      auto block = static_cast<const ast::BlockStatement *>(stmt);
+      auto index = add(Tag::BLOCK, *block);
+      std::vector<Index> children;
+      children.reserve(block->statements.size());
+      for (const auto &child : block->statements) {
+        children.push_back(statement(child.get()));
+      }
+      setList(index, children);
+      return index;
+    }
+    }
+    return NONE;
+  }
+
+  Index expression(const ast::Expression *expr) {
+    if (expr == nullptr) {
+      return NONE;
+    }
+    switch (expr->Type()) {
+    case ast::ExpressionType::IDENTIFIER: {
+      auto ident = static_cast<const ast::Identifier *>(expr);
+      auto index = add(Tag::IDENTIFIER, *ident);
+      tree_.nodes[index].a = ident->symbol;
+      return index;
+    }
+    case ast::ExpressionType::INTEGER: {
+      auto integer = static_cast<const ast::IntegerLiteral *>(expr);
+      auto index = add(Tag::INTEGER, *integer);
+      auto bits = static_cast<uint64_t>(integer->value);
+      tree_.nodes[index].a = static_cast<Index>(bits);
+      tree_.nodes[index].b = static_cast<Index>(bits >> 32);
+      return index;
+    }
+    case ast::ExpressionType::BOOLEAN: {
+      auto boolean = static_cast<const ast::Boolean *>(expr);
+      auto index = add(Tag::BOOLEAN, *boolean);
+      tree_.nodes[index].a = boolean->value;
+      return index;
+    }
+    case ast::ExpressionType::PREFIX: {
+      auto prefix = static_cast<const ast::PrefixExpression *>(expr);
+      auto index = add(Tag::PREFIX, *prefix);
+      auto right = expression(prefix->right.get());
+      tree_.nodes[index].a = right;
+      return index;
+    }
+    case ast::ExpressionType::INFIX: {
+      auto infix = static_cast<const ast::InfixExpression *>(expr);
+      auto index = add(Tag::INFIX, *infix);
+      auto left = expression(infix->left.get());
+      auto right = expression(infix->right.get());
+      tree_.nodes[index].a = left;
+      tree_.nodes[index].b = right;
+      return index;
+    }
+    case ast::ExpressionType::IF: {
+      auto ifExpr = static_cast<const ast::IfExpression *>(expr);
+      auto index = add(Tag::IF, *ifExpr);
+      auto condition = expression(ifExpr->condition.get());
+      auto consequence = statement(ifExpr->consequence.get());
+      auto alternative = statement(ifExpr->alternative.get());
+      tree_.nodes[index].a = condition;
+      tree_.nodes[index].b = consequence;
+      tree_.nodes[index].c = alternative;
+      return index;
+    }
+    case ast::ExpressionType::FUNCTION: {
+      auto fn = static_cast<const ast::FunctionLiteral *>(expr);
+      auto index = add(Tag::FUNCTION, *fn);
+      std::vector<Index> params;
+      params.reserve(fn->parameters.size());
+      for (const auto &param : fn->parameters) {
+        params.push_back(expression(param.get()));
+      }
+      auto body = statement(fn->body.get());
+      tree_.nodes[index].a = static_cast<Index>(tree_.lists.size());
+      tree_.nodes[index].b = static_cast<Index>(params.size());
+      tree_.nodes[index].c = body;
+      tree_.lists.insert(tree_.lists.end(), params.begin(), params.end());
+      return index;
+    }
+    case ast::ExpressionType::CALL: {
+      auto call = static_cast<const ast::CallExpression *>(expr);
+      auto index = add(Tag::CALL, *call);
+      auto function = expression(call->function.get());
+      tree_.nodes[index].a = function;
+      setList(index, expressions(call->arguments));
+      return index;
+    }
+    case ast::ExpressionType::STRING:
+      return add(Tag::STRING, *expr);
+    case ast::ExpressionType::ARRAY: {
+      auto array = static_cast<const ast::ArrayLiteral *>(expr);
+      auto index = add(Tag::ARRAY, *array);
+      setList(index, expressions(array->elements));
+      return index;
+    }
+    }
+    return NONE;
+  }
+
+private:
+  Index add(Tag tag, const ast::Node &node) {
+    auto text = tree_.source->text();
+    auto literal = node.literal();
+    if (literal.data() < text.data() ||
+        literal.data() + literal.size() > text.end()) {
+      throw std::invalid_argument("token '" + std::string(literal) +
+                                  "' does not point into the source");
+    }
+    tree_.nodes.push_back(
+        Node{tag, node.tokenType(),
+             static_cast<uint32_t>(literal.data() - text.data()),
+             static_cast<uint32_t>(literal.size())});
+    return static_cast<Index>(tree_.nodes.size() - 1);
+  }
+
+  std::vector<Index> expressions(const ast::Arguments &list) {
+    std::vector<Index> children;
+    children.reserve(list.size());
+    for (const auto &child : list) {
+      children.push_back(expression(child.get()));
+    }
+    return children;
+  }
+
+  // Lists are appended after their members, so nested lists never
+  // interleave with the one being built.
+  void setList(Index index, const std::vector<Index> &children) {
+    tree_.nodes[index].b = static_cast<Index>(tree_.lists.size());
+    tree_.nodes[index].c = static_cast<Index>(children.size());
+    tree_.lists.insert(tree_.lists.end(), children.begin(), children.end());
+  }
+
+  Tree &tree_;
+};
+
+class Unflattener {
+public:
+  Unflattener(const Tree &tree, ast::Arena &arena)
+      : tree_(tree), arena_(arena) {}
+
+  ast::Ptr<ast::Statement> statement(Index index) {
+    if (index == NONE) {
+      return nullptr;
+    }
+    const auto &node = tree_[index];
+    switch (node.tag) {
+    case Tag::LET: {
+      auto let = arena_.make<ast::LetStatement>(token(node));
+      let->name = identifier(node.a);
+      let->value = expression(node.b);
+      return let;
+    }
+    case Tag::RETURN: {
+      auto ret = arena_.make<ast::ReturnStatement>(token(node));
+      ret->returnValue = expression(node.a);
+      return ret;
+    }
+    case Tag::EXPRESSION: {
+      auto stmt = arena_.make<ast::ExpressionStatement>(token(node));
+      stmt->expression = expression(node.a);
+      return stmt;
+    }
+    case Tag::BLOCK:
+      return block(index);
+    default:
+      return nullptr;
+    }
+  }
+
+  ast::Ptr<ast::Expression> expression(Index index) {
+    if (index == NONE) {
+      return nullptr;
+    }
+    const auto &node = tree_[index];
+    switch (node.tag) {
+    case Tag::IDENTIFIER:
+      return identifier(index);
+    case Tag::INTEGER: {
+      auto integer = arena_.make<ast::IntegerLiteral>(token(node));
+      integer->value = integerValue(node);
+      return integer;
+    }
+    case Tag::BOOLEAN:
+      return arena_.make<ast::Boolean>(token(node), node.a != 0);
+    case Tag::PREFIX: {
+      auto prefix = arena_.make<ast::PrefixExpression>(token(node));
+      prefix->right = expression(node.a);
+      return prefix;
+    }
+    case Tag::INFIX: {
+      auto infix = arena_.make<ast::InfixExpression>(token(node));
+      infix->left = expression(node.a);
+      infix->right = expression(node.b);
+      return infix;
+    }
+    case Tag::IF: {
+      auto ifExpr = arena_.make<ast::IfExpression>(token(node));
+      ifExpr->condition = expression(node.a);
+      ifExpr->consequence = block(node.b);
+      ifExpr->alternative = block(node.c);
+      return ifExpr;
+    }
+    case Tag::FUNCTION: {
+      auto fn = arena_.make<ast::FunctionLiteral>(token(node));
+      for (auto param : tree_.list(node.a, node.b)) {
+        fn->parameters.push_back(identifier(param));
+      }
+      fn->body = block(node.c);
+      return fn;
+    }
+    case Tag::CALL: {
+      auto call = arena_.make<ast::CallExpression>(token(node));
+      call->function = expression(node.a);
+      for (auto arg : tree_.list(node.b, node.c)) {
+        call->arguments.push_back(expression(arg));
+      }
+      return call;
+    }
+    case Tag::STRING:
+      return arena_.make<ast::StringLiteral>(token(node));
+    case Tag::ARRAY: {
+      auto array = arena_.make<ast::ArrayLiteral>(token(node));
+      for (auto elem : tree_.list(node.b, node.c)) {
+        array->elements.push_back(expression(elem));
+      }
+      return array;
+    }
+    default:
+      return nullptr;
+    }
+  }
+
+private:
+  lexer::Token token(const Node &node) const {
+    int64_t payload = 0;
+    if (node.tag == Tag::IDENTIFIER) {
+      payload = node.a;
+    } else if (node.tag == Tag::INTEGER) {
+      payload = integerValue(node);
+    }
+    return lexer::Token(node.tokenType, tree_.literal(node), payload);
+  }
+
+  static int64_t integerValue(const Node &node) {
+    return static_cast<int64_t>(static_cast<uint64_t>(node.b) << 32 | node.a);
+  }
+
+  ast::Ptr<ast::Identifier> identifier(Index index) {
+    if (index == NONE) {
+      return nullptr;
+    }
+    return arena_.make<ast::Identifier>(token(tree_[index]));
+  }
+
+  ast::Ptr<ast::BlockStatement> block(Index index) {
+    if (index == NONE) {
+      return nullptr;
+    }
+    const auto &node = tree_[index];
+    auto block = arena_.make<ast::BlockStatement>(token(node));
+    for (auto stmt : tree_.list(node.b, node.c)) {
+      block->statements.push_back(statement(stmt));
+    }
+    return block;
+  }
+
+  const Tree &tree_;
+  ast::Arena &arena_;
+};
+
+void append(const Tree &tree, Index index, std::string &out);
+
+void appendList(const Tree &tree, std::span<const Index> list,
+                std::string &out) {
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (i > 0) {
+      out += ", ";
+    }
+    append(tree, list[i], out);
+  }
+}
+
+void append(const Tree &tree, Index index, std::string &out) {
+  if (index == NONE) {
+    return;
+  }
+  const auto &node = tree[index];
+  switch (node.tag) {
+  case Tag::LET:
+    out += tree.literal(node);
+    out += " ";
+    append(tree, node.a, out);
+    out += " = ";
+    append(tree, node.b, out);
+    out += ";";
+    break;
+  case Tag::RETURN:
+    out += tree.literal(node);
+    out += " ";
+    append(tree, node.a, out);
+    out += ";";
+    break;
+  case Tag::EXPRESSION:
+    append(tree, node.a, out);
+    break;
+  case Tag::BLOCK:
+    for (auto stmt : tree.list(node.b, node.c)) {
+      append(tree, stmt, out);
+    }
+    break;
+  case Tag::PREFIX:
+    out += "(";
+    out += tree.literal(node);
+    append(tree, node.a, out);
+    out += ")";
+    break;
+  case Tag::INFIX:
+    out += "(";
+    append(tree, node.a, out);
+    out += " ";
+    out += tree.literal(node);
+    out += " ";
+    append(tree, node.b, out);
+    out += ")";
+    break;
+  case Tag::IF:
+    out += "if";
+    if (node.a != NONE) {
+      out += " ";
+      append(tree, node.a, out);
+    }
+    out += " ";
+    append(tree, node.b, out);
+    if (node.c != NONE) {
+      out += " else ";
+      append(tree, node.c, out);
+    }
+    break;
+  case Tag::FUNCTION:
+    out += tree.literal(node);
+    out += "(";
+    appendList(tree, tree.list(node.a, node.b), out);
+    out += ") ";
+    append(tree, node.c, out);
+    break;
+  case Tag::CALL:
+    append(tree, node.a, out);
+    out += "(";
+    appendList(tree, tree.list(node.b, node.c), out);
+    out += ")";
+    break;
+  case Tag::ARRAY:
+    out += "[";
+    appendList(tree, tree.list(node.b, node.c), out);
+    out += "]";
+    break;
+  case Tag::IDENTIFIER:
+  case Tag::INTEGER:
+  case Tag::BOOLEAN:
+  case Tag::STRING:
+    out += tree.literal(node);
+    break;
+  }
+}
+
+} // namespace
+
+size_t Tree::memoryUsage() const {
+  return nodes.capacity() * sizeof(Node) +
+         (lists.capacity() + statements.capacity()) * sizeof(Index);
+}
+
+Tree flatten(const ast::Program &program) {
+  if (program.source == nullptr) {
+    throw std::invalid_argument("cannot flatten a program without source");
+  }
+  if (program.source->size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("source too large for 32-bit node offsets");
+  }
+  Tree tree;
+  tree.source = program.source;
+  Flattener flattener(tree);
+  tree.statements.reserve(program.statements.size());
+  for (const auto &stmt : program.statements) {
+    tree.statements.push_back(flattener.statement(stmt.get()));
+  }
+  return tree;
+}
+
+std::unique_ptr<ast::Program> unflatten(const Tree &tree) {
+  auto arena = std::make_shared<ast::Arena>(
+      std::max<size_t>(4096, tree.nodes.size() * 64));
+  arena->retain(tree.source);
+  auto program = std::make_unique<ast::Program>(arena);
+  program->source = tree.source;
+  Unflattener unflattener(tree, *arena);
+  program->statements.reserve(tree.statements.size());
+  for (auto stmt : tree.statements) {
+    program->statements.push_back(unflattener.statement(stmt));
+  }
+  return program;
+}
+
+std::string to_string(const Tree &tree) {
+  std::string out;
+  for (auto stmt : tree.statements) {
+    append(tree, stmt, out);
+  }
+  return out;
+}
+
+} // namespace monkey::parser::flat
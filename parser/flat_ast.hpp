@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../lexer/source.hpp"
+#include "../lexer/token.hpp"
+#include "ast.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace monkey::parser::flat {
+
+// Position of a node in Tree::nodes, or of a child list in Tree::lists.
+using Index = uint32_t;
+inline constexpr Index NONE = UINT32_MAX;
+
+enum class Tag : uint8_t {
+  LET,
+  RETURN,
+  EXPRESSION,
+  BLOCK,
+  IDENTIFIER,
+  INTEGER,
+  BOOLEAN,
+  PREFIX,
+  INFIX,
+  IF,
+  FUNCTION,
+  CALL,
+  STRING,
+  ARRAY,
+};
+
+// One AST node in 24 bytes. The token literal is a span of the source; the
+// meaning of a, b and c depends on the tag:
+//   LET         a = name, b = value
+//   RETURN      a = return value
+//   EXPRESSION  a = expression
+//   BLOCK       b, c = statements (list start, count)
+//   IDENTIFIER  a = symbol
+//   INTEGER     a, b = low and high 32 bits of the value
+//   BOOLEAN     a = value
+//   PREFIX      a = right operand
+//   INFIX       a = left operand, b = right operand
+//   IF          a = condition, b = consequence, c = alternative
+//   FUNCTION    a, b = parameters (list start, count), c = body
+//   CALL        a = function, b, c = arguments (list start, count)
+//   STRING      -
+//   ARRAY       b, c = elements (list start, count)
+// Missing children are NONE.
+struct Node {
+  Tag tag;
+  lexer::TokenType tokenType;
+  uint32_t offset;
+  uint32_t length;
+  Index a = NONE;
+  Index b = NONE;
+  Index c = NONE;
+};
+
+// A whole program as plain arrays: no pointers, no vtables, and children
+// are found by index, so a walk touches contiguous memory and the tree can
+// be copied or written out as is. String data stays in the source.
+struct Tree {
+  lexer::SourcePtr source;
+  std::vector<Node> nodes;
+  // Child lists of blocks, calls, arrays and functions, back to back.
+  std::vector<Index> lists;
+  std::vector<Index> statements;
+
+  const Node &operator[](Index index) const { return nodes[index]; }
+  std::span<const Index> list(Index begin, Index count) const {
+    return {lists.data() + begin, count};
+  }
+  std::string_view literal(const Node &node) const {
+    return source->text().substr(node.offset, node.length);
+  }
+  // Bytes held by the arrays above, not counting the source.
+  size_t memoryUsage() const;
+};
+
+// Copies a parsed program into flat form. Every token must point into
+// program.source; throws std::invalid_argument otherwise (e.g. for trees
+// built by hand), and std::length_error for a source over 4 GiB, past what
+// node offsets can hold.
+Tree flatten(const ast::Program &program);
+// Rebuilds the node classes from a flat tree, in a new arena.
+std::unique_ptr<ast::Program> unflatten(const Tree &tree);
+// Same output as ast::Program::to_string of the tree it was built from.
+std::string to_string(const Tree &tree);
+
+} // namespace monkey::parser::flat
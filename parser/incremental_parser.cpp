@@ -0,0 +1,133 @@
+#include "incremental_parser.hpp"
+#include "../lexer/lexer.hpp"
+#include "arena.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace monkey::parser {
+
+namespace {
+
+// A fresh parse would take about this many bytes; once the versions kept
+// alive by shared statements exceed it this many times over, reparse
+// starts over instead.
+constexpr size_t kBytesPerToken = 32;
+constexpr size_t kMaxRetainedRatio = 2;
+
+std::shared_ptr<ast::Arena> newArena(const lexer::TokenStream &tokens,
+                                     size_t expectedTokens) {
+  auto arena = std::make_shared<ast::Arena>(
+      std::max<size_t>(4096, expectedTokens * kBytesPerToken));
+  arena->retain(tokens.source());
+  return arena;
+}
+
+ParsedScript parseTokens(lexer::TokenStream tokens) {
+  ParsedScript script;
+  script.tokens = std::move(tokens);
+  auto arena = newArena(script.tokens, script.tokens.size());
+  script.program = std::make_unique<ast::Program>(arena);
+  script.program->source = script.tokens.source();
+  Parser p(&script.tokens);
+  p.setArena(arena);
+  while (!p.atEnd()) {
+    auto start = static_cast<uint32_t>(p.position());
+    auto statement = p.parseNextStatement();
+    if (statement != nullptr) {
+      script.statementStarts.push_back(start);
+      script.program->statements.push_back(std::move(statement));
+    }
+  }
+  script.errors = p.getErrors();
+  script.retainedBytes = arena->reserved() + script.tokens.source()->size();
+  return script;
+}
+
+} // namespace
+
+ParsedScript parseScript(lexer::SourcePtr source) {
+  return parseTokens(lexer::Lexer(source).tokenizeAll());
+}
+
+ParsedScript reparse(const ParsedScript &old, const lexer::TextEdit &edit) {
+  if (old.program == nullptr) {
+    throw std::invalid_argument("reparse needs a script from parseScript");
+  }
+  auto relexed = lexer::relex(old.tokens, edit);
+  auto &tokens = relexed.tokens;
+  auto fresh = tokens.size() * kBytesPerToken + tokens.source()->size();
+  if (!old.errors.empty() ||
+      old.retainedBytes > kMaxRetainedRatio * fresh) {
+    return parseTokens(std::move(tokens));
+  }
+
+  const auto &starts = old.statementStarts;
+  const auto &oldStatements = old.program->statements;
+  size_t count = starts.size();
+  auto oldEof = old.tokens.size() - 1;
+  // Statement i was parsed looking at most one token past its end, which
+  // is where statement i + 1 (or EOF) starts. It can be kept if that token
+  // comes before the first changed one.
+  size_t prefix = 0;
+  while (prefix < count &&
+         (prefix + 1 < count ? starts[prefix + 1] : oldEof) <
+             relexed.firstChanged) {
+    prefix++;
+  }
+  // Old statements from `suffix` on start in the unchanged tail; where one
+  // of them would start in the new stream, parsing can stop.
+  auto suffix = static_cast<size_t>(
+      std::lower_bound(starts.begin() + prefix, starts.end(),
+                       relexed.oldEnd) -
+      starts.begin());
+  auto moved = [&](size_t i) {
+    return starts[i] - relexed.oldEnd + relexed.newEnd;
+  };
+
+  ParsedScript script;
+  auto begin = prefix < count ? starts[prefix] : oldEof;
+  auto arena =
+      newArena(tokens, relexed.newEnd > begin ? relexed.newEnd - begin : 0);
+  arena->retain(old.program->arena);
+  script.program = std::make_unique<ast::Program>(arena);
+  script.program->source = tokens.source();
+  auto share = [&](size_t i, size_t start) {
+    // Arena nodes are never deleted through a Ptr, so both programs can
+    // hold the same statement.
+    script.program->statements.emplace_back(oldStatements[i].get());
+    script.statementStarts.push_back(static_cast<uint32_t>(start));
+    script.reusedStatements++;
+  };
+  for (size_t i = 0; i < prefix; i++) {
+    share(i, starts[i]);
+  }
+
+  Parser p(&tokens, begin);
+  p.setArena(arena);
+  while (!p.atEnd()) {
+    auto position = p.position();
+    while (suffix < count && moved(suffix) < position) {
+      suffix++;
+    }
+    if (suffix < count && moved(suffix) == position) {
+      break;
+    }
+    auto statement = p.parseNextStatement();
+    if (statement != nullptr) {
+      script.statementStarts.push_back(static_cast<uint32_t>(position));
+      script.program->statements.push_back(std::move(statement));
+    }
+  }
+  if (!p.atEnd()) {
+    for (size_t i = suffix; i < count; i++) {
+      share(i, moved(i));
+    }
+  }
+  script.errors = p.getErrors();
+  script.tokens = std::move(tokens);
+  script.retainedBytes = old.retainedBytes + arena->reserved() +
+                         script.tokens.source()->size();
+  return script;
+}
+
+} // namespace monkey::parser
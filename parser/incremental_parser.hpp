@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../lexer/incremental_lexer.hpp"
+#include "../lexer/source.hpp"
+#include "../lexer/token_stream.hpp"
+#include "ast.hpp"
+#include "parser.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace monkey::parser {
+
+// One version of a script being edited: its tree, the tokens it was parsed
+// from, and where each top-level statement starts in them.
+struct ParsedScript {
+  std::unique_ptr<ast::Program> program;
+  lexer::TokenStream tokens;
+  Errors errors;
+  // Token index of the first token of each statement in program.
+  std::vector<uint32_t> statementStarts;
+  // Statements taken over from the previous version by reparse.
+  size_t reusedStatements = 0;
+  // Bytes of arenas and source texts this version keeps alive, its own and
+  // those of earlier versions it shares statements with.
+  size_t retainedBytes = 0;
+};
+
+ParsedScript parseScript(lexer::SourcePtr source);
+
+// Applies edit to old and parses the result. Only the region the edit can
+// have affected is parsed again. Top-level statements before it, and those
+// after it once the parser is back at an unchanged statement boundary, are
+// shared with old rather than copied, so the parsing work is proportional
+// to the edit. The call as a whole is not: relex copies the text and the
+// tokens (see there), and the new version gets its own list of statement
+// pointers and starts, all O(script) copies. The tree is the same as
+// parseScript of the edited text would give. Falls back to a full parse
+// when old had errors (its statement boundaries are then unreliable) or
+// when earlier versions kept alive through shared statements outweigh a
+// fresh parse.
+//
+// Shared statements still point into the text of the version they were
+// parsed from, so Program::locate works only for the freshly parsed ones.
+// Throws std::invalid_argument if old did not come from parseScript or
+// reparse.
+ParsedScript reparse(const ParsedScript &old, const lexer::TextEdit &edit);
+
+} // namespace monkey::parser
@@ -0,0 +1,313 @@
+#include "mkc.hpp"
+#include "../lexer/symbol.hpp"
+#include "parser.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace monkey::parser::mkc {
+
+namespace {
+
+using flat::Index;
+using flat::NONE;
+using flat::Tag;
+
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+size_t padded(size_t bytes) { return (bytes + 7) & ~size_t{7}; }
+
+template <typename T>
+void appendArray(std::string &out, uint64_t &offset, uint64_t &count,
+                 const std::vector<T> &items) {
+  offset = out.size();
+  count = items.size();
+  out.append(reinterpret_cast<const char *>(items.data()),
+             items.size() * sizeof(T));
+  out.resize(padded(out.size()));
+}
+
+template <typename T>
+std::vector<T> readArray(std::string_view bytes, uint64_t offset,
+                         uint64_t count, const char *what) {
+  if (offset % alignof(T) != 0 || offset > bytes.size() ||
+      count > (bytes.size() - offset) / sizeof(T)) {
+    throw FormatError(std::string(what) + " lie outside the file");
+  }
+  std::vector<T> items(count);
+  std::memcpy(items.data(), bytes.data() + offset, count * sizeof(T));
+  return items;
+}
+
+bool isStatement(Tag tag) {
+  return tag == Tag::LET || tag == Tag::RETURN || tag == Tag::EXPRESSION ||
+         tag == Tag::BLOCK;
+}
+
+// Checks that the nodes form a forest the unflattener can walk: every
+// reference points forward to a node of the right kind that nothing else
+// references, and every span and list is in bounds. Children always follow
+// their parent in a flattened tree, so this also rules out cycles, and a
+// node's level is known by the time it is reached: no statement may be
+// taller than the parser allows, or unflatten would run out of stack.
+class Validator {
+public:
+  explicit Validator(const flat::Tree &tree)
+      : tree_(tree), levels_(tree.nodes.size()) {}
+
+  void run() {
+    for (auto stmt : tree_.statements) {
+      child(stmt, 0, isStatement, false, true);
+    }
+    for (Index i = 0; i < tree_.nodes.size(); i++) {
+      node(i);
+    }
+  }
+
+private:
+  void node(Index index) {
+    const auto &node = tree_.nodes[index];
+    if (node.tag > Tag::ARRAY) {
+      fail(index, "unknown tag");
+    }
+    if (node.offset > tree_.source->size() ||
+        node.length > tree_.source->size() - node.offset) {
+      fail(index, "token outside the source");
+    }
+    auto expression = [](Tag tag) { return !isStatement(tag); };
+    auto identifier = [](Tag tag) { return tag == Tag::IDENTIFIER; };
+    auto block = [](Tag tag) { return tag == Tag::BLOCK; };
+    switch (node.tag) {
+    case Tag::LET:
+      child(node.a, index, identifier);
+      child(node.b, index, expression);
+      break;
+    case Tag::RETURN:
+    case Tag::EXPRESSION:
+    case Tag::PREFIX:
+      child(node.a, index, expression);
+      break;
+    case Tag::INFIX:
+      child(node.a, index, expression);
+      child(node.b, index, expression);
+      break;
+    case Tag::IF:
+      child(node.a, index, expression);
+      child(node.b, index, block);
+      child(node.c, index, block, true);
+      break;
+    case Tag::FUNCTION:
+      list(node.a, node.b, index, identifier);
+      child(node.c, index, block);
+      break;
+    case Tag::CALL:
+      child(node.a, index, expression);
+      list(node.b, node.c, index, expression);
+      break;
+    case Tag::BLOCK:
+      list(node.b, node.c, index, isStatement);
+      break;
+    case Tag::ARRAY:
+      list(node.b, node.c, index, expression);
+      break;
+    case Tag::IDENTIFIER:
+    case Tag::INTEGER:
+    case Tag::BOOLEAN:
+    case Tag::STRING:
+      break;
+    }
+  }
+
+  void child(Index child, Index parent, bool (*kind)(Tag),
+             bool optional = false, bool root = false) {
+    if (child == NONE && optional) {
+      return;
+    }
+    if (child >= tree_.nodes.size() || (!root && child <= parent) ||
+        !kind(tree_.nodes[child].tag)) {
+      fail(parent, "bad child reference");
+    }
+    if (levels_[child] != 0) {
+      fail(child, "node referenced twice");
+    }
+    levels_[child] = root ? 1 : levels_[parent] + 1;
+    if (levels_[child] > Parser::kDefaultMaxHeight) {
+      fail(child, "statement too tall");
+    }
+  }
+
+  void list(Index begin, Index count, Index parent, bool (*kind)(Tag)) {
+    if (begin > tree_.lists.size() || count > tree_.lists.size() - begin) {
+      fail(parent, "child list outside the file");
+    }
+    for (auto item : tree_.list(begin, count)) {
+      child(item, parent, kind);
+    }
+  }
+
+  [[noreturn]] void fail(Index index, const char *what) {
+    throw FormatError("node " + std::to_string(index) + ": " + what);
+  }
+
+  const flat::Tree &tree_;
+  // Level of each node within its statement, 1 for the statement itself;
+  // 0 until something references it.
+  std::vector<uint32_t> levels_;
+};
+
+void writeAll(int fd, std::string_view bytes, const std::string &path) {
+  while (!bytes.empty()) {
+    auto written = ::write(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+  }
+}
+
+const Header &readHeader(std::string_view bytes) {
+  if (bytes.size() < sizeof(Header)) {
+    throw FormatError("file is too short for a header");
+  }
+  auto header = reinterpret_cast<const Header *>(bytes.data());
+  if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw FormatError("not a compiled monkey script");
+  }
+  if (header->byteOrder != BYTE_ORDER_MARK) {
+    throw FormatError("written on a machine of different byte order");
+  }
+  if (header->version != FORMAT_VERSION ||
+      header->nodeSize != sizeof(flat::Node)) {
+    throw FormatError("format version " + std::to_string(header->version) +
+                      ", expected " + std::to_string(FORMAT_VERSION));
+  }
+  return *header;
+}
+
+} // namespace
+
+uint64_t hashSource(std::string_view text) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : text) {
+    hash = (hash ^ c) * 0x100000001b3;
+  }
+  return hash;
+}
+
+std::string serialize(const flat::Tree &tree) {
+  auto text = tree.source->text();
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = FORMAT_VERSION;
+  header.nodeSize = sizeof(flat::Node);
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.sourceHash = hashSource(text);
+
+  std::string out(sizeof(Header), '\0');
+  header.sourceOffset = out.size();
+  header.sourceLength = text.size();
+  out.append(text);
+  out.resize(padded(out.size()));
+  auto nodes = tree.nodes;
+  std::unordered_map<lexer::Symbol, Index> local;
+  std::vector<Index> symbols;
+  for (Index i = 0; i < nodes.size(); i++) {
+    if (nodes[i].tag == Tag::IDENTIFIER) {
+      auto [it, added] =
+          local.emplace(nodes[i].a, static_cast<Index>(symbols.size()));
+      if (added) {
+        symbols.push_back(i);
+      }
+      nodes[i].a = it->second;
+    }
+  }
+  appendArray(out, header.nodesOffset, header.nodeCount, nodes);
+  appendArray(out, header.listsOffset, header.listCount, tree.lists);
+  appendArray(out, header.statementsOffset, header.statementCount,
+              tree.statements);
+  appendArray(out, header.symbolsOffset, header.symbolCount, symbols);
+  std::memcpy(out.data(), &header, sizeof(Header));
+  return out;
+}
+
+void write(const std::string &path, const flat::Tree &tree) {
+  auto bytes = serialize(tree);
+  auto temporary = path + ".tmp" + std::to_string(getpid());
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), temporary);
+  }
+  try {
+    writeAll(fd, bytes, temporary);
+  } catch (...) {
+    close(fd);
+    unlink(temporary.c_str());
+    throw;
+  }
+  if (close(fd) != 0 || rename(temporary.c_str(), path.c_str()) != 0) {
+    auto err = errno;
+    unlink(temporary.c_str());
+    throw std::system_error(err, std::generic_category(), path);
+  }
+}
+
+flat::Tree deserialize(lexer::SourcePtr file) {
+  auto bytes = file->text();
+  const auto &header = readHeader(bytes);
+  flat::Tree tree;
+  if (header.sourceOffset > bytes.size() ||
+      header.sourceLength > bytes.size() - header.sourceOffset) {
+    throw FormatError("source text lies outside the file");
+  }
+  tree.source = lexer::Source::slice(file, header.sourceOffset,
+                                     header.sourceLength);
+  if (hashSource(tree.source->text()) != header.sourceHash) {
+    throw FormatError("source text does not match its hash");
+  }
+  tree.nodes = readArray<flat::Node>(bytes, header.nodesOffset,
+                                     header.nodeCount, "nodes");
+  tree.lists = readArray<Index>(bytes, header.listsOffset, header.listCount,
+                                "child lists");
+  tree.statements = readArray<Index>(bytes, header.statementsOffset,
+                                     header.statementCount, "statements");
+  if (tree.nodes.size() >= NONE) {
+    throw FormatError("too many nodes");
+  }
+  auto symbols = readArray<Index>(bytes, header.symbolsOffset,
+                                  header.symbolCount, "symbols");
+  Validator(tree).run();
+  for (auto &symbol : symbols) {
+    if (symbol >= tree.nodes.size() ||
+        tree.nodes[symbol].tag != Tag::IDENTIFIER) {
+      throw FormatError("symbol table entry is not an identifier");
+    }
+    symbol = lexer::intern(tree.literal(tree.nodes[symbol]));
+  }
+  for (auto &node : tree.nodes) {
+    if (node.tag == Tag::IDENTIFIER) {
+      if (node.a >= symbols.size()) {
+        throw FormatError("identifier has no symbol table entry");
+      }
+      node.a = symbols[node.a];
+    }
+  }
+  return tree;
+}
+
+std::unique_ptr<ast::Program> load(const std::string &path) {
+  return flat::unflatten(deserialize(lexer::Source::mapFile(path)));
+}
+
+uint64_t recordedHash(const std::string &path) {
+  return readHeader(lexer::Source::mapFile(path)->text()).sourceHash;
+}
+
+} // namespace monkey::parser::mkc
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../lexer/source.hpp"
+#include "ast.hpp"
+#include "flat_ast.hpp"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Compiled scripts (.mkc): a parsed program in flat form, with the script
+// text embedded, laid out so that a read-only mapping of the file can be
+// used directly. All fields are little-endian and 8-byte aligned:
+//
+//   Header
+//   source text               (sourceLength bytes, padded)
+//   flat::Node[nodeCount]
+//   flat::Index[listCount]
+//   flat::Index[statementCount]
+//   flat::Index[symbolCount]
+//
+// Symbols are process-local, so an identifier node's symbol field holds a
+// file-local number instead: an index into the symbol table, whose entries
+// name an identifier node spelling that symbol. Loading interns each name
+// once and renumbers the nodes.
+//
+// The header records a hash of the script text, FNV-1a with 64-bit
+// parameters, so a file written by one build can be checked by any other.
+namespace monkey::parser::mkc {
+
+inline constexpr char MAGIC[4] = {'M', 'K', 'C', '\0'};
+// Bump whenever the layout of the header or of flat::Node changes.
+inline constexpr uint32_t FORMAT_VERSION = 2;
+inline constexpr std::string_view EXTENSION = ".mkc";
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t nodeSize;
+  uint32_t byteOrder;
+  // hashSource of the script text, to tell whether a .mkc is stale.
+  uint64_t sourceHash;
+  uint64_t sourceOffset;
+  uint64_t sourceLength;
+  uint64_t nodesOffset;
+  uint64_t nodeCount;
+  uint64_t listsOffset;
+  uint64_t listCount;
+  uint64_t statementsOffset;
+  uint64_t statementCount;
+  uint64_t symbolsOffset;
+  uint64_t symbolCount;
+};
+
+// A file that is not a compiled script of this version, or is corrupt.
+class FormatError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// 64-bit FNV-1a of text.
+uint64_t hashSource(std::string_view text);
+
+std::string serialize(const flat::Tree &tree);
+// Writes serialize(tree) to path, via a temporary file renamed into place
+// so readers never see a partial file. Throws std::system_error.
+void write(const std::string &path, const flat::Tree &tree);
+
+// Reads a tree back from the bytes of a .mkc file; the tree's source is a
+// slice of file. Every index and span is checked, and statements are held
+// to Parser::kDefaultMaxHeight, so a corrupt file throws FormatError rather
+// than producing a tree that unflatten would misread or recurse too deep on.
+flat::Tree deserialize(lexer::SourcePtr file);
+// Maps the file at path and deserializes it, then rebuilds the program.
+// Throws std::system_error if the file cannot be read.
+std::unique_ptr<ast::Program> load(const std::string &path);
+// The hash recorded in the file at path, read without loading the tree.
+uint64_t recordedHash(const std::string &path);
+
+} // namespace monkey::parser::mkc
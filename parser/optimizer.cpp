@@ -0,0 +1,875 @@
+#include "optimizer.hpp"
+#include "ast_walk.hpp"
+#include "resolver.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace monkey::parser::opt {
+
+namespace {
+
+using ast::ExpressionType;
+using ast::Op;
+using ast::StatementType;
+
+// Walks the tree children first, so a node is rewritten after everything
+// below it, and lets subclasses replace expressions and edit statement
+// lists on the way back up.
+class Rewriter : public Pass {
+public:
+  size_t run(ast::Statements &statements, ast::Arena &arena) override {
+    arena_ = &arena;
+    rewrites_ = 0;
+    visit(statements);
+    return rewrites_;
+  }
+
+protected:
+  virtual void rewrite(ast::Ptr<ast::Expression> & /*expression*/) {}
+  virtual void rewrite(ast::Statements & /*statements*/) {}
+  // For passes that follow scopes: called around each statement list and
+  // each function body, and after each statement of a list.
+  virtual void enter(ast::Statements & /*statements*/) {}
+  virtual void leave(ast::Statements & /*statements*/) {}
+  virtual void enter(ast::FunctionLiteral & /*function*/) {}
+  virtual void leave(ast::FunctionLiteral & /*function*/) {}
+  virtual void visited(ast::Statement & /*statement*/) {}
+
+  ast::Arena &arena() { return *arena_; }
+
+  ast::Ptr<ast::Expression> integer(int64_t value) {
+    auto text = arena_->copy(std::to_string(value));
+    auto literal =
+        arena_->make<ast::IntegerLiteral>(lexer::Token{lexer::TokenType::INT,
+                                                       text, value});
+    literal->value = value;
+    rewrites_++;
+    return literal;
+  }
+
+  ast::Ptr<ast::Expression> boolean(bool value) {
+    auto token = value ? lexer::Token{lexer::TokenType::TRUE, "true"}
+                       : lexer::Token{lexer::TokenType::FALSE, "false"};
+    rewrites_++;
+    return arena_->make<ast::Boolean>(token, value);
+  }
+
+  ast::Ptr<ast::Expression> string(std::string_view value) {
+    auto text = arena_->copy(value);
+    rewrites_++;
+    return arena_->make<ast::StringLiteral>(
+        lexer::Token{lexer::TokenType::STRING, text});
+  }
+
+  size_t rewrites_ = 0;
+
+private:
+  void visit(ast::Statements &statements) {
+    enter(statements);
+    for (auto &statement : statements) {
+      visit(statement.get());
+      if (statement != nullptr) {
+        visited(*statement);
+      }
+    }
+    leave(statements);
+    rewrite(statements);
+  }
+
+  void visit(ast::BlockStatement *block) {
+    if (block != nullptr) {
+      visit(block->statements);
+    }
+  }
+
+  void visit(ast::Statement *statement) {
+    if (statement == nullptr) {
+      return;
+    }
+    switch (statement->Type()) {
+    case StatementType::LET:
+      visit(static_cast<ast::LetStatement *>(statement)->value);
+      break;
+    case StatementType::RETURN:
+      visit(static_cast<ast::ReturnStatement *>(statement)->returnValue);
+      break;
+    case StatementType::EXPRESSION:
+      visit(static_cast<ast::ExpressionStatement *>(statement)->expression);
+      break;
+    case StatementType::BLOCK:
+      visit(static_cast<ast::BlockStatement *>(statement));
+      break;
+    }
+  }
+
+  void visit(ast::Ptr<ast::Expression> &expression) {
+    if (expression == nullptr) {
+      return;
+    }
+    switch (expression->Type()) {
+    case ExpressionType::PREFIX:
+      visit(static_cast<ast::PrefixExpression &>(*expression).right);
+      break;
+    case ExpressionType::INFIX: {
+      auto &infix = static_cast<ast::InfixExpression &>(*expression);
+      visit(infix.left);
+      visit(infix.right);
+      break;
+    }
+    case ExpressionType::IF: {
+      auto &node = static_cast<ast::IfExpression &>(*expression);
+      visit(node.condition);
+      visit(node.consequence.get());
+      visit(node.alternative.get());
+      break;
+    }
+    case ExpressionType::FUNCTION: {
+      auto &function = static_cast<ast::FunctionLiteral &>(*expression);
+      enter(function);
+      visit(function.body.get());
+      leave(function);
+      break;
+    }
+    case ExpressionType::CALL: {
+      auto &call = static_cast<ast::CallExpression &>(*expression);
+      visit(call.function);
+      for (auto &argument : call.arguments) {
+        visit(argument);
+      }
+      break;
+    }
+    case ExpressionType::ARRAY:
+      for (auto &element : static_cast<ast::ArrayLiteral &>(*expression)
+                               .elements) {
+        visit(element);
+      }
+      break;
+    default:
+      break;
+    }
+    rewrite(expression);
+  }
+
+  ast::Arena *arena_ = nullptr;
+};
+
+bool isType(const ast::Ptr<ast::Expression> &expression, ExpressionType type) {
+  return expression != nullptr && expression->Type() == type;
+}
+
+int64_t integerValue(const ast::Ptr<ast::Expression> &expression) {
+  return static_cast<const ast::IntegerLiteral &>(*expression).value;
+}
+
+bool booleanValue(const ast::Ptr<ast::Expression> &expression) {
+  return static_cast<const ast::Boolean &>(*expression).value;
+}
+
+class FoldConstants : public Rewriter {
+public:
+  std::string_view name() const override { return "fold-constants"; }
+
+protected:
+  void rewrite(ast::Ptr<ast::Expression> &expression) override {
+    if (expression->Type() == ExpressionType::PREFIX) {
+      auto &prefix = static_cast<ast::PrefixExpression &>(*expression);
+      if (auto folded = fold(prefix)) {
+        expression = std::move(folded);
+      }
+    } else if (expression->Type() == ExpressionType::INFIX) {
+      auto &infix = static_cast<ast::InfixExpression &>(*expression);
+      if (auto folded = fold(infix)) {
+        expression = std::move(folded);
+      }
+    }
+  }
+
+private:
+  ast::Ptr<ast::Expression> fold(const ast::PrefixExpression &prefix) {
+    const auto &right = prefix.right;
+    if (prefix.op == Op::MINUS && isType(right, ExpressionType::INTEGER) &&
+        integerValue(right) != std::numeric_limits<int64_t>::min()) {
+      return integer(-integerValue(right));
+    }
+    if (prefix.op == Op::BANG) {
+      if (isType(right, ExpressionType::BOOLEAN)) {
+        return boolean(!booleanValue(right));
+      }
+      // Integers and strings are never false or null.
+      if (isType(right, ExpressionType::INTEGER) ||
+          isType(right, ExpressionType::STRING)) {
+        return boolean(false);
+      }
+    }
+    return nullptr;
+  }
+
+  ast::Ptr<ast::Expression> fold(const ast::InfixExpression &infix) {
+    if (isType(infix.left, ExpressionType::INTEGER) &&
+        isType(infix.right, ExpressionType::INTEGER)) {
+      return fold(infix.op, integerValue(infix.left),
+                  integerValue(infix.right));
+    }
+    if (isType(infix.left, ExpressionType::BOOLEAN) &&
+        isType(infix.right, ExpressionType::BOOLEAN)) {
+      auto left = booleanValue(infix.left);
+      auto right = booleanValue(infix.right);
+      if (infix.op == Op::EQ) {
+        return boolean(left == right);
+      } else if (infix.op == Op::NOT_EQ) {
+        return boolean(left != right);
+      }
+    }
+    return nullptr;
+  }
+
+  ast::Ptr<ast::Expression> fold(Op op, int64_t left, int64_t right) {
+    int64_t result;
+    switch (op) {
+    case Op::PLUS:
+      if (__builtin_add_overflow(left, right, &result)) {
+        return nullptr;
+      }
+      return integer(result);
+    case Op::MINUS:
+      if (__builtin_sub_overflow(left, right, &result)) {
+        return nullptr;
+      }
+      return integer(result);
+    case Op::ASTERISK:
+      if (__builtin_mul_overflow(left, right, &result)) {
+        return nullptr;
+      }
+      return integer(result);
+    case Op::SLASH:
+      if (right == 0 ||
+          (left == std::numeric_limits<int64_t>::min() && right == -1)) {
+        return nullptr;
+      }
+      return integer(left / right);
+    case Op::LT:
+      return boolean(left < right);
+    case Op::GT:
+      return boolean(left > right);
+    case Op::EQ:
+      return boolean(left == right);
+    case Op::NOT_EQ:
+      return boolean(left != right);
+    default:
+      return nullptr;
+    }
+  }
+};
+
+class ConcatenateStrings : public Rewriter {
+public:
+  std::string_view name() const override { return "concatenate-strings"; }
+
+protected:
+  void rewrite(ast::Ptr<ast::Expression> &expression) override {
+    if (expression->Type() != ExpressionType::INFIX) {
+      return;
+    }
+    auto &infix = static_cast<ast::InfixExpression &>(*expression);
+    if (infix.op != Op::PLUS || !isType(infix.left, ExpressionType::STRING) ||
+        !isType(infix.right, ExpressionType::STRING)) {
+      return;
+    }
+    auto left = static_cast<ast::StringLiteral &>(*infix.left).value();
+    auto right = static_cast<ast::StringLiteral &>(*infix.right).value();
+    // A node's text length is 32 bits.
+    if (left.size() + right.size() > std::numeric_limits<uint32_t>::max()) {
+      return;
+    }
+    expression = string(std::string(left) + std::string(right));
+  }
+};
+
+class PruneBranches : public Rewriter {
+public:
+  std::string_view name() const override { return "prune-branches"; }
+
+protected:
+  void rewrite(ast::Ptr<ast::Expression> &expression) override {
+    if (expression->Type() != ExpressionType::IF) {
+      return;
+    }
+    ast::BlockStatement *taken;
+    if (!takenBranch(static_cast<ast::IfExpression &>(*expression), taken) ||
+        taken == nullptr || taken->statements.size() != 1 ||
+        taken->statements[0]->Type() != StatementType::EXPRESSION) {
+      return;
+    }
+    auto &statement =
+        static_cast<ast::ExpressionStatement &>(*taken->statements[0]);
+    if (statement.expression == nullptr) {
+      return;
+    }
+    auto replacement = std::move(statement.expression);
+    expression = std::move(replacement);
+    rewrites_++;
+  }
+
+  void rewrite(ast::Statements &statements) override {
+    for (size_t i = 0; i < statements.size();) {
+      auto *statement = statements[i].get();
+      ast::BlockStatement *taken;
+      if (statement == nullptr ||
+          statement->Type() != StatementType::EXPRESSION) {
+        i++;
+        continue;
+      }
+      auto &expression =
+          static_cast<ast::ExpressionStatement *>(statement)->expression;
+      if (!isType(expression, ExpressionType::IF) ||
+          !takenBranch(static_cast<ast::IfExpression &>(*expression),
+                       taken)) {
+        i++;
+        continue;
+      }
+      if (taken == nullptr || taken->statements.empty()) {
+        // The last statement's value is the value of the list.
+        if (i + 1 == statements.size()) {
+          i++;
+        } else {
+          statements.erase(statements.begin() + i);
+          rewrites_++;
+        }
+        continue;
+      }
+      auto body = std::move(taken->statements);
+      auto at = statements.erase(statements.begin() + i);
+      statements.insert(at, std::make_move_iterator(body.begin()),
+                        std::make_move_iterator(body.end()));
+      i += body.size();
+      rewrites_++;
+    }
+  }
+
+private:
+  // Whether node's condition is a literal, and if so the branch it takes,
+  // null for a missing `else`.
+  static bool takenBranch(const ast::IfExpression &node,
+                          ast::BlockStatement *&taken) {
+    bool truthy;
+    if (isType(node.condition, ExpressionType::BOOLEAN)) {
+      truthy = booleanValue(node.condition);
+    } else if (isType(node.condition, ExpressionType::INTEGER) ||
+               isType(node.condition, ExpressionType::STRING)) {
+      truthy = true;
+    } else {
+      return false;
+    }
+    taken = truthy ? node.consequence.get() : node.alternative.get();
+    return true;
+  }
+};
+
+class RemoveUnreachable : public Rewriter {
+public:
+  std::string_view name() const override { return "remove-unreachable"; }
+
+protected:
+  void rewrite(ast::Statements &statements) override {
+    for (size_t i = 0; i < statements.size(); i++) {
+      if (statements[i] != nullptr &&
+          statements[i]->Type() == StatementType::RETURN) {
+        rewrites_ += statements.size() - i - 1;
+        statements.erase(statements.begin() + i + 1, statements.end());
+        return;
+      }
+    }
+  }
+};
+
+class InlineFunctions : public Rewriter {
+public:
+  InlineFunctions(bool globals, size_t budget)
+      : globals_(globals), budget_(budget) {}
+
+  std::string_view name() const override { return "inline-functions"; }
+
+  size_t run(ast::Statements &statements, ast::Arena &arena) override {
+    // Each decision is explained once per program, not once per round.
+    if (logged_ != explainedIn_) {
+      explained_.clear();
+      explainedIn_ = logged_;
+    }
+    scopes_.assign(1, Scope{});
+    for (auto &statement : statements) {
+      declareLets(scopes_[0], statement.get());
+    }
+    auto rewrites = Rewriter::run(statements, arena);
+    scopes_.clear();
+    return rewrites;
+  }
+
+protected:
+  void enter(ast::FunctionLiteral &function) override {
+    scopes_.push_back(Scope{&function, {}});
+    auto &scope = scopes_.back();
+    for (auto &param : function.parameters) {
+      scope.names[param->symbol].parameter = true;
+    }
+    declareLets(scope, function.body.get());
+  }
+
+  void leave(ast::FunctionLiteral &) override { scopes_.pop_back(); }
+
+  void enter(ast::Statements &) override {
+    marks_.push_back(bound_.size());
+  }
+
+  void leave(ast::Statements &) override {
+    bound_.resize(marks_.back());
+    marks_.pop_back();
+  }
+
+  void visited(ast::Statement &statement) override {
+    if (statement.Type() == StatementType::LET) {
+      auto &let = static_cast<ast::LetStatement &>(statement);
+      bound_.push_back({let.name->symbol, scopes_.size() - 1});
+    }
+  }
+
+  void rewrite(ast::Ptr<ast::Expression> &expression) override {
+    if (expression->Type() != ExpressionType::CALL) {
+      return;
+    }
+    auto &call = static_cast<ast::CallExpression &>(*expression);
+    if (!isType(call.function, ExpressionType::IDENTIFIER)) {
+      return;
+    }
+    auto &callee = static_cast<const ast::Identifier &>(*call.function);
+    auto scope = declaringScope(callee.symbol);
+    if (scope == NO_SCOPE) {
+      return;
+    }
+    const auto &name = scopes_[scope].names.at(callee.symbol);
+    if (name.let == nullptr ||
+        !isType(name.let->value, ExpressionType::FUNCTION)) {
+      return;
+    }
+    std::string reason;
+    if (name.lets > 1 || name.parameter) {
+      reason = "it is bound more than once";
+    } else if (scope == 0 && !globals_) {
+      reason = "later input may rebind it";
+    } else if (isDefining(*name.let->value)) {
+      reason = "it is called from its own body";
+    } else if (!isBound(callee.symbol, scope)) {
+      reason = "it may be called before it is bound";
+    } else {
+      reason = whyNot(static_cast<ast::FunctionLiteral &>(*name.let->value),
+                      call, callee.symbol, scope);
+    }
+    if (!reason.empty()) {
+      log(callee, "not inlining " + callee.to_string() + ": " + reason);
+      return;
+    }
+    auto &function = static_cast<ast::FunctionLiteral &>(*name.let->value);
+    for (size_t i = 0; i < call.arguments.size(); i++) {
+      arguments_[function.parameters[i]->symbol] = call.arguments[i].get();
+    }
+    auto inlined = copy(body(function), true);
+    arguments_.clear();
+    log(callee, "inlined " + callee.to_string());
+    expression = std::move(inlined);
+    rewrites_++;
+  }
+
+private:
+  static constexpr size_t NO_SCOPE = std::numeric_limits<size_t>::max();
+
+  struct Name {
+    bool parameter = false;
+    size_t lets = 0;
+    // The first `let` binding the name.
+    const ast::LetStatement *let = nullptr;
+  };
+
+  // The names a function, or the top level, binds.
+  struct Scope {
+    // Null for the top level.
+    const ast::FunctionLiteral *function = nullptr;
+    std::unordered_map<lexer::Symbol, Name> names;
+  };
+
+  // A `let` that has run by the current point of the walk.
+  struct Bound {
+    lexer::Symbol name;
+    size_t scope;
+  };
+
+  static void declareLets(Scope &scope, ast::Statement *node) {
+    if (node == nullptr) {
+      return;
+    }
+    if (node->Type() == StatementType::LET) {
+      auto *let = static_cast<ast::LetStatement *>(node);
+      auto &name = scope.names[let->name->symbol];
+      if (name.lets++ == 0) {
+        name.let = let;
+      }
+    }
+    ast::forEachChild(*node, [&](auto *child) { declareLets(scope, child); });
+  }
+
+  static void declareLets(Scope &scope, ast::Expression *node) {
+    if (node != nullptr && node->Type() != ExpressionType::FUNCTION) {
+      ast::forEachChild(*node,
+                        [&](auto *child) { declareLets(scope, child); });
+    }
+  }
+
+  // Innermost scope binding name, or NO_SCOPE.
+  size_t declaringScope(lexer::Symbol name) const {
+    for (size_t i = scopes_.size(); i > 0; i--) {
+      if (scopes_[i - 1].names.count(name) != 0) {
+        return i - 1;
+      }
+    }
+    return NO_SCOPE;
+  }
+
+  // Whether name, bound in scope, is sure to be bound at this point.
+  bool isBound(lexer::Symbol name, size_t scope) const {
+    if (scopes_[scope].names.at(name).parameter) {
+      return true;
+    }
+    return std::any_of(bound_.begin(), bound_.end(), [&](const Bound &b) {
+      return b.name == name && b.scope == scope;
+    });
+  }
+
+  // Whether the walk is inside function.
+  bool isDefining(const ast::Expression &function) const {
+    return std::any_of(scopes_.begin(), scopes_.end(), [&](const Scope &s) {
+      return s.function == &function;
+    });
+  }
+
+  static ast::Expression *body(ast::FunctionLiteral &function) {
+    if (function.body == nullptr || function.body->statements.size() != 1) {
+      return nullptr;
+    }
+    auto *statement = function.body->statements[0].get();
+    if (statement->Type() == StatementType::EXPRESSION) {
+      return static_cast<ast::ExpressionStatement *>(statement)
+          ->expression.get();
+    } else if (statement->Type() == StatementType::RETURN) {
+      return static_cast<ast::ReturnStatement *>(statement)->returnValue.get();
+    }
+    return nullptr;
+  }
+
+  // Why the call to function, named self and bound in scope, cannot be
+  // inlined; empty if it can.
+  std::string whyNot(ast::FunctionLiteral &function,
+                     const ast::CallExpression &call, lexer::Symbol self,
+                     size_t scope) const {
+    auto &parameters = function.parameters;
+    if (call.arguments.size() != parameters.size()) {
+      return "it takes " + std::to_string(parameters.size()) +
+             " arguments, not " + std::to_string(call.arguments.size());
+    }
+    std::unordered_set<lexer::Symbol> params;
+    for (auto &param : parameters) {
+      if (!params.insert(param->symbol).second) {
+        return "it repeats a parameter";
+      }
+    }
+    auto *expression = body(function);
+    if (expression == nullptr) {
+      return "its body is not a single expression";
+    }
+    Shape shape;
+    measure(expression, shape);
+    if (!shape.reason.empty()) {
+      return shape.reason;
+    }
+    if (shape.nodes > budget_) {
+      return "its body has " + std::to_string(shape.nodes) +
+             " nodes, over the budget of " + std::to_string(budget_);
+    }
+    for (auto *identifier : shape.identifiers) {
+      auto symbol = identifier->symbol;
+      if (symbol == self) {
+        return "it refers to itself";
+      }
+      // Between where the function was bound and the call, nothing may
+      // bind the names its body uses.
+      if (params.count(symbol) == 0) {
+        for (size_t i = scope + 1; i < scopes_.size(); i++) {
+          if (scopes_[i].names.count(symbol) != 0) {
+            return identifier->to_string() + " means something else here";
+          }
+        }
+      }
+    }
+    for (size_t i = 0; i < call.arguments.size(); i++) {
+      const auto &argument = call.arguments[i];
+      bool literal = isType(argument, ExpressionType::INTEGER) ||
+                     isType(argument, ExpressionType::BOOLEAN) ||
+                     isType(argument, ExpressionType::STRING);
+      bool bound = false;
+      if (isType(argument, ExpressionType::IDENTIFIER)) {
+        auto symbol = static_cast<ast::Identifier &>(*argument).symbol;
+        auto declared = declaringScope(symbol);
+        bound = declared != NO_SCOPE && isBound(symbol, declared);
+      }
+      if (!literal && !bound) {
+        return "argument " + std::to_string(i + 1) +
+               " is neither a literal nor a bound name";
+      }
+    }
+    return "";
+  }
+
+  struct Shape {
+    size_t nodes = 0;
+    std::vector<ast::Identifier *> identifiers;
+    // Set if the body cannot be copied to the call.
+    std::string reason;
+  };
+
+  static void measure(ast::Statement *node, Shape &shape) {
+    if (node == nullptr) {
+      return;
+    }
+    shape.nodes++;
+    // Blocks share the caller's environment once inlined, and a return
+    // would leave the caller.
+    if (node->Type() == StatementType::LET ||
+        node->Type() == StatementType::RETURN) {
+      shape.reason = "its body binds names or returns";
+    }
+    ast::forEachChild(*node, [&](auto *child) { measure(child, shape); });
+  }
+
+  static void measure(ast::Expression *node, Shape &shape) {
+    if (node == nullptr) {
+      return;
+    }
+    shape.nodes++;
+    if (node->Type() == ExpressionType::IDENTIFIER) {
+      shape.identifiers.push_back(static_cast<ast::Identifier *>(node));
+    } else if (node->Type() == ExpressionType::FUNCTION) {
+      shape.reason = "its body makes a closure";
+      return;
+    }
+    ast::forEachChild(*node, [&](auto *child) { measure(child, shape); });
+  }
+
+  // A copy of node in the arena, with the arguments in place of the
+  // parameters if substitute is set.
+  ast::Ptr<ast::Expression> copy(const ast::Expression *node,
+                                 bool substitute) {
+    if (node == nullptr) {
+      return nullptr;
+    }
+    lexer::Token token{node->tokenType(), node->literal()};
+    switch (node->Type()) {
+    case ExpressionType::IDENTIFIER: {
+      auto symbol = static_cast<const ast::Identifier *>(node)->symbol;
+      auto argument = arguments_.find(symbol);
+      if (substitute && argument != arguments_.end()) {
+        return copy(argument->second, false);
+      }
+      token.payload = symbol;
+      return arena().make<ast::Identifier>(token);
+    }
+    case ExpressionType::INTEGER: {
+      auto literal = arena().make<ast::IntegerLiteral>(token);
+      literal->value = static_cast<const ast::IntegerLiteral *>(node)->value;
+      return literal;
+    }
+    case ExpressionType::BOOLEAN:
+      return arena().make<ast::Boolean>(
+          token, static_cast<const ast::Boolean *>(node)->value);
+    case ExpressionType::STRING:
+      return arena().make<ast::StringLiteral>(token);
+    case ExpressionType::PREFIX: {
+      auto prefix = arena().make<ast::PrefixExpression>(token);
+      prefix->right = copy(
+          static_cast<const ast::PrefixExpression *>(node)->right.get(),
+          substitute);
+      return prefix;
+    }
+    case ExpressionType::INFIX: {
+      auto &original = static_cast<const ast::InfixExpression &>(*node);
+      auto infix = arena().make<ast::InfixExpression>(token);
+      infix->left = copy(original.left.get(), substitute);
+      infix->right = copy(original.right.get(), substitute);
+      return infix;
+    }
+    case ExpressionType::IF: {
+      auto &original = static_cast<const ast::IfExpression &>(*node);
+      auto ifExpr = arena().make<ast::IfExpression>(token);
+      ifExpr->condition = copy(original.condition.get(), substitute);
+      ifExpr->consequence = copy(original.consequence.get(), substitute);
+      ifExpr->alternative = copy(original.alternative.get(), substitute);
+      return ifExpr;
+    }
+    case ExpressionType::CALL: {
+      auto &original = static_cast<const ast::CallExpression &>(*node);
+      auto call = arena().make<ast::CallExpression>(token);
+      call->function = copy(original.function.get(), substitute);
+      for (auto &argument : original.arguments) {
+        call->arguments.push_back(copy(argument.get(), substitute));
+      }
+      return call;
+    }
+    case ExpressionType::ARRAY: {
+      auto array = arena().make<ast::ArrayLiteral>(token);
+      for (auto &element :
+           static_cast<const ast::ArrayLiteral *>(node)->elements) {
+        array->elements.push_back(copy(element.get(), substitute));
+      }
+      return array;
+    }
+    default:
+      // Function literals are never copied.
+      return nullptr;
+    }
+  }
+
+  // Blocks of an inlined body only hold expression statements.
+  ast::Ptr<ast::BlockStatement> copy(const ast::BlockStatement *block,
+                                     bool substitute) {
+    if (block == nullptr) {
+      return nullptr;
+    }
+    auto copied = arena().make<ast::BlockStatement>(
+        lexer::Token{block->tokenType(), block->literal()});
+    for (auto &statement : block->statements) {
+      auto &original =
+          static_cast<const ast::ExpressionStatement &>(*statement);
+      auto copiedStatement = arena().make<ast::ExpressionStatement>(
+          lexer::Token{original.tokenType(), original.literal()});
+      copiedStatement->expression =
+          copy(original.expression.get(), substitute);
+      copied->statements.push_back(std::move(copiedStatement));
+    }
+    return copied;
+  }
+
+  void log(const ast::Node &at, const std::string &message) {
+    if (log_ == nullptr || !explained_.emplace(&at, message).second) {
+      return;
+    }
+    if (logged_ != nullptr) {
+      try {
+        auto location = logged_->locate(at);
+        *log_ << location.line << ":" << location.column << ": ";
+      } catch (const std::out_of_range &) {
+        // Not parsed from the program's source.
+      }
+    }
+    *log_ << message << "\n";
+  }
+
+  bool globals_;
+  size_t budget_;
+  // The top level and the functions around the node being visited,
+  // innermost last.
+  std::vector<Scope> scopes_;
+  std::vector<Bound> bound_;
+  // Size of bound_ when each statement list being visited was entered.
+  std::vector<size_t> marks_;
+  // Parameters of the function being inlined, and their arguments.
+  std::unordered_map<lexer::Symbol, const ast::Expression *> arguments_;
+  // What has been logged about which call, for the program explainedIn_.
+  std::set<std::pair<const ast::Node *, std::string>> explained_;
+  const ast::Program *explainedIn_ = nullptr;
+};
+
+} // namespace
+
+std::unique_ptr<Pass> foldConstants() {
+  return std::make_unique<FoldConstants>();
+}
+
+std::unique_ptr<Pass> concatenateStrings() {
+  return std::make_unique<ConcatenateStrings>();
+}
+
+std::unique_ptr<Pass> pruneBranches() {
+  return std::make_unique<PruneBranches>();
+}
+
+std::unique_ptr<Pass> removeUnreachable() {
+  return std::make_unique<RemoveUnreachable>();
+}
+
+std::unique_ptr<Pass> inlineFunctions(bool globals, size_t budget) {
+  return std::make_unique<InlineFunctions>(globals, budget);
+}
+
+PassManager::PassManager(int level, bool wholeProgram) {
+  if (level < 0 || level > kMaxLevel) {
+    throw std::invalid_argument("no optimisation level " +
+                                std::to_string(level));
+  }
+  if (level >= 1) {
+    add(foldConstants());
+    add(concatenateStrings());
+  }
+  if (level >= 2) {
+    add(inlineFunctions(wholeProgram));
+    add(pruneBranches());
+    add(removeUnreachable());
+    maxRounds_ = 4;
+  }
+  resolve_ = level >= 1;
+}
+
+void PassManager::add(std::unique_ptr<Pass> pass) {
+  passes_.push_back(std::move(pass));
+}
+
+size_t PassManager::run(ast::Program &program, std::ostream *dump,
+                        std::ostream *log) {
+  if (program.arena == nullptr) {
+    throw std::invalid_argument("cannot optimise a program without an arena");
+  }
+  if (dump != nullptr) {
+    *dump << "before: " << program.to_string() << "\n";
+  }
+  for (auto &pass : passes_) {
+    pass->setLog(log, &program);
+  }
+  size_t total = 0;
+  for (size_t round = 0; round < maxRounds_; round++) {
+    size_t rewrites = 0;
+    for (auto &pass : passes_) {
+      auto count = pass->run(program.statements, *program.arena);
+      if (dump != nullptr && count != 0) {
+        *dump << pass->name() << ": " << count << " rewrites\n";
+      }
+      rewrites += count;
+    }
+    total += rewrites;
+    if (rewrites == 0) {
+      break;
+    }
+  }
+  if (resolve_) {
+    resolveScopes(program.statements);
+  }
+  if (dump != nullptr) {
+    *dump << "after: " << program.to_string() << "\n";
+  }
+  return total;
+}
+
+} // namespace monkey::parser::opt
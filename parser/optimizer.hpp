@@ -0,0 +1,103 @@
+#pragma once
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace monkey::parser::opt {
+
+// A rewrite of a parsed tree that keeps what evaluating it does, errors
+// included; anything whose result depends on the evaluator's error paths
+// is left alone.
+class Pass {
+public:
+  virtual ~Pass() = default;
+  virtual std::string_view name() const = 0;
+  // Rewrites statements in place, making new nodes in arena, and returns
+  // how many rewrites it made.
+  virtual size_t run(ast::Statements &statements, ast::Arena &arena) = 0;
+  // Where to explain the decisions the pass makes, if anywhere; positions
+  // are those of nodes in program.
+  void setLog(std::ostream *log, const ast::Program *program) {
+    log_ = log;
+    logged_ = program;
+  }
+
+protected:
+  std::ostream *log_ = nullptr;
+  const ast::Program *logged_ = nullptr;
+};
+
+// Operators on integer and boolean literals, e.g. `2 * (5 + 10)` becomes
+// `30`. Overflow, division by zero and `-` on the smallest integer are
+// left for the evaluator.
+std::unique_ptr<Pass> foldConstants();
+// `"a" + "b"` becomes `"ab"`.
+std::unique_ptr<Pass> concatenateStrings();
+// An `if` on a literal condition is replaced by the branch it takes: by
+// its expression if the branch is a single expression, or, as a statement,
+// by the branch's statements, since blocks share the enclosing scope.
+std::unique_ptr<Pass> pruneBranches();
+// Drops the statements after a `return` in a block or program.
+std::unique_ptr<Pass> removeUnreachable();
+
+// Size of the largest function body inlineFunctions copies, in nodes.
+inline constexpr size_t DEFAULT_INLINE_BUDGET = 16;
+
+// Replaces calls to small functions by their bodies, e.g. with
+// `let add = fn(a, b) { a + b };`, `add(x, 1)` becomes `(x + 1)`. The
+// callee must be named by a `let` that binds it once in its scope and has
+// run by the time of the call: one earlier in the same statement list, or
+// in one enclosing it. Its body must be a single expression of at most
+// budget nodes that makes no closures, binds no names and does not refer
+// to the function itself; the names it uses must mean the same at the
+// call. Arguments are substituted for the parameters, so each must be a
+// literal or a name bound at the call, which cannot fail and costs the
+// same however often it is evaluated. The definition is kept, so it does
+// not matter where else the function goes.
+//
+// Functions bound at the top level are only inlined with globals, since
+// otherwise later input to the same environment might rebind them.
+std::unique_ptr<Pass> inlineFunctions(bool globals = true,
+                                      size_t budget = DEFAULT_INLINE_BUDGET);
+
+// Runs the passes of an optimisation level over whole programs:
+//   0  none
+//   1  foldConstants, concatenateStrings
+//   2  all of the above and inlineFunctions, repeated while inlining,
+//      pruning and dead code removal expose more to fold.
+// From level 1 on, the rewritten program's scopes are then resolved (see
+// resolveScopes in resolver.hpp).
+//
+// Programs are rewritten in place. Statements shared with another program
+// (see reparse) are rewritten for both, so only optimise programs that own
+// their statements. Folded literals have text of their own rather than a
+// span of the source, so an optimised program cannot be flattened and
+// Program::locate does not apply to them.
+class PassManager {
+public:
+  static constexpr int kMaxLevel = 2;
+  // wholeProgram says that nothing else will run in the environments the
+  // programs are evaluated in; the REPL, say, passes false.
+  explicit PassManager(int level = 1, bool wholeProgram = true);
+
+  void add(std::unique_ptr<Pass> pass);
+  // Returns the total number of rewrites. With dump, writes the tree
+  // before and after the passes and what each pass rewrote; with log, the
+  // decisions passes explain. Throws std::invalid_argument for a program
+  // without an arena.
+  size_t run(ast::Program &program, std::ostream *dump = nullptr,
+             std::ostream *log = nullptr);
+
+private:
+  std::vector<std::unique_ptr<Pass>> passes_;
+  // Times the passes are run over a program at most; a round that rewrites
+  // nothing ends it early.
+  size_t maxRounds_ = 1;
+  bool resolve_ = false;
+};
+
+} // namespace monkey::parser::opt
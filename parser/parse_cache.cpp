@@ -0,0 +1,83 @@
+#include "parse_cache.hpp"
+#include "../lexer/lexer.hpp"
+#include "arena.hpp"
+#include <functional>
+#include <string>
+
+namespace monkey::parser {
+
+ParseCache::ParseCache(size_t capacityBytes) : capacity_(capacityBytes) {}
+
+std::shared_ptr<const CachedParse> ParseCache::parse(std::string_view text) {
+  auto hash = std::hash<std::string_view>{}(text);
+  {
+    std::lock_guard lock(mutex_);
+    auto found = index_.find(hash);
+    if (found != index_.end() &&
+        found->second->second->program->source->text() == text) {
+      lru_.splice(lru_.begin(), lru_, found->second);
+      stats_.hits++;
+      return found->second->second;
+    }
+    stats_.misses++;
+  }
+
+  auto parsed = parseSource(lexer::makeSource(std::string(text)));
+  if (parsed->footprint > capacity_) {
+    return parsed;
+  }
+
+  std::lock_guard lock(mutex_);
+  auto found = index_.find(hash);
+  if (found != index_.end()) {
+    // Another thread parsed the same text meanwhile, or a different text
+    // with the same hash is resident; the newest parse wins.
+    stats_.bytes -= found->second->second->footprint;
+    lru_.erase(found->second);
+    index_.erase(found);
+  }
+  lru_.emplace_front(hash, parsed);
+  index_.emplace(hash, lru_.begin());
+  stats_.bytes += parsed->footprint;
+  evictLocked();
+  return parsed;
+}
+
+std::shared_ptr<const CachedParse>
+ParseCache::parseSource(lexer::SourcePtr source) {
+  lexer::Lexer l(source);
+  Parser p(&l);
+  auto result = std::make_shared<CachedParse>();
+  std::shared_ptr<ast::Program> program = p.parseProgram();
+  result->errors = p.getErrors();
+  result->footprint = source->size() + program->arena->reserved() +
+                      sizeof(CachedParse) + sizeof(ast::Program);
+  result->program = std::move(program);
+  return result;
+}
+
+void ParseCache::evictLocked() {
+  while (stats_.bytes > capacity_ && !lru_.empty()) {
+    auto &[hash, entry] = lru_.back();
+    stats_.bytes -= entry->footprint;
+    stats_.evictions++;
+    index_.erase(hash);
+    lru_.pop_back();
+  }
+}
+
+ParseCache::Stats ParseCache::stats() const {
+  std::lock_guard lock(mutex_);
+  auto stats = stats_;
+  stats.entries = lru_.size();
+  return stats;
+}
+
+void ParseCache::clear() {
+  std::lock_guard lock(mutex_);
+  lru_.clear();
+  index_.clear();
+  stats_.bytes = 0;
+}
+
+} // namespace monkey::parser
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../lexer/source.hpp"
+#include "ast.hpp"
+#include "parser.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace monkey::parser {
+
+// A parsed script as the cache hands it out. Shared and never modified, so
+// any number of threads may evaluate the same program at once.
+struct CachedParse {
+  std::shared_ptr<const ast::Program> program;
+  Errors errors;
+  // Bytes charged against the cache: the source text plus the arena.
+  size_t footprint = 0;
+};
+
+// Parses scripts at most once while they stay resident. Entries are keyed
+// by a 64-bit hash of the text, confirmed by comparing the text itself, and
+// the least recently used ones are evicted once their combined footprint
+// exceeds the capacity. Thread-safe; parsing on a miss runs outside the
+// lock.
+class ParseCache {
+public:
+  static constexpr size_t kDefaultCapacity = 64 << 20;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  explicit ParseCache(size_t capacityBytes = kDefaultCapacity);
+  ParseCache(const ParseCache &) = delete;
+  ParseCache &operator=(const ParseCache &) = delete;
+
+  // The parse of text: a cached one if present, otherwise a fresh one that
+  // is cached unless it alone exceeds the capacity.
+  std::shared_ptr<const CachedParse> parse(std::string_view text);
+  Stats stats() const;
+  void clear();
+
+private:
+  using Entry = std::shared_ptr<const CachedParse>;
+  using Lru = std::list<std::pair<uint64_t, Entry>>;
+
+  static std::shared_ptr<const CachedParse>
+  parseSource(lexer::SourcePtr source);
+  void evictLocked();
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  Lru lru_;
+  std::unordered_map<uint64_t, Lru::iterator> index_;
+  Stats stats_;
+};
+
+} // namespace monkey::parser
@@ -1,44 +1,121 @@
 #include "parser.hpp"
 #include "ast.hpp"
+#include <algorithm>
 #include <memory>
+#include <thread>
 
 namespace monkey {
 namespace parser {
 
+namespace {
+template <typename Fn> void runOnThreads(size_t count, Fn fn) {
+  std::vector<std::thread> workers;
+  workers.reserve(count - 1);
+  for (size_t i = 1; i < count; i++) {
+    workers.emplace_back(fn, i);
+  }
+  fn(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// The statements one worker parsed from [begin, end) of the stream.
+struct Part {
+  std::shared_ptr<ast::Arena> arena;
+  std::vector<ast::Ptr<ast::Statement>> statements;
+  Errors errors;
+  // Where the worker's parser stopped: end, unless the last statement ran
+  // past it.
+  size_t stop = 0;
+};
+
+// What parseStatement does next: start parsing the construct at curToken,
+// or hand the one it just finished to the frame on top of the stack.
+enum class Step {
+  STATEMENT,
+  EXPRESSION,
+  BLOCK,
+  STATEMENT_DONE,
+  EXPRESSION_DONE,
+  BLOCK_DONE,
+};
+
+bool startsExpression(lexer::TokenType type) {
+  switch (type) {
+  case lexer::TokenType::IDENT:
+  case lexer::TokenType::INT:
+  case lexer::TokenType::BANG:
+  case lexer::TokenType::MINUS:
+  case lexer::TokenType::TRUE:
+  case lexer::TokenType::FALSE:
+  case lexer::TokenType::LPAREN:
+  case lexer::TokenType::IF:
+  case lexer::TokenType::FUNCTION:
+  case lexer::TokenType::STRING:
+  case lexer::TokenType::LBRACKET:
+    return true;
+  default:
+    return false;
+  }
+}
+
+template <typename T> ast::Ptr<T> adopt(ast::Node *node) {
+  return ast::Ptr<T>(static_cast<T *>(node));
+}
+} // namespace
+
 Parser::Parser(lexer::Lexer *l) : l(l) {
   nextToken(); // set curToken
   nextToken(); // set peekToken
+}
 
-  registerPrefix(lexer::TokenType::IDENT, &Parser::parseIdentifier);
-  registerPrefix(lexer::TokenType::INT, &Parser::parseIntegerLiteral);
-  registerPrefix(lexer::TokenType::BANG, &Parser::parsePrefixExpression);
-  registerPrefix(lexer::TokenType::MINUS, &Parser::parsePrefixExpression);
-  registerPrefix(lexer::TokenType::TRUE, &Parser::parseBoolean);
-  registerPrefix(lexer::TokenType::FALSE, &Parser::parseBoolean);
-  registerPrefix(lexer::TokenType::LPAREN, &Parser::parseGroupedExpression);
-  registerPrefix(lexer::TokenType::IF, &Parser::parseIfExpression);
-  registerPrefix(lexer::TokenType::FUNCTION, &Parser::parseFunctionLiteral);
-  registerPrefix(lexer::TokenType::STRING, &Parser::parseStringLiteral);
-  registerPrefix(lexer::TokenType::LBRACKET, &Parser::parseArrayLiteral);
-
-  registerInfix(lexer::TokenType::PLUS, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::MINUS, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::SLASH, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::ASTERISK, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::EQ, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::NOT_EQ, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::LT, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::GT, &Parser::parseInfixExpression);
-  registerInfix(lexer::TokenType::LPAREN, &Parser::parseCallExpression);
+Parser::Parser(const lexer::TokenStream *tokens, size_t begin)
+    : tokens(tokens), tokenIndex(begin) {
+  nextToken(); // set curToken
+  nextToken(); // set peekToken
+}
+
+Parser::Parser(lexer::PipelinedLexer *pipeline) : pipeline(pipeline) {
+  nextToken(); // set curToken
+  nextToken(); // set peekToken
+}
+
+Parser::Parser(lexer::StreamLexer *stream) : stream(stream) {
+  nextToken(); // set curToken
+  nextToken(); // set peekToken
 }
 
 void Parser::nextToken() {
   curToken = peekToken;
-  peekToken = l->nextToken();
+  if (l) {
+    peekToken = l->nextToken();
+  } else if (tokens) {
+    peekToken = tokens->token(tokenIndex++);
+  } else if (stream) {
+    curWindow = std::move(peekWindow);
+    peekToken = stream->nextToken();
+    peekWindow = stream->source();
+    // Windows are read in order, so each one is retained once, when its
+    // first token comes in.
+    if (arena != nullptr && peekWindow != curWindow) {
+      arena->retain(peekWindow);
+    }
+  } else {
+    peekToken = pipeline->nextToken();
+  }
 }
 
 std::unique_ptr<ast::Program> Parser::parseProgram() {
-  auto program = std::make_unique<ast::Program>();
+  auto source = inputSource();
+  // A pre-lexed stream tells us roughly how big the tree will get.
+  size_t initialBytes = tokens ? std::max<size_t>(4096, tokens->size() * 32)
+                               : 4096;
+  arena = std::make_shared<ast::Arena>(initialBytes);
+  arena->retain(source);
+  retainWindows();
+  auto program = std::make_unique<ast::Program>(arena);
+  program->source = std::move(source);
 
   while (not curTokenIs(lexer::TokenType::EOFILE)) {
     auto statement = parseStatement();
@@ -50,91 +127,594 @@ std::unique_ptr<ast::Program> Parser::parseProgram() {
   return program;
 }
 
-std::unique_ptr<ast::Statement> Parser::parseStatement() {
-  switch (curToken.type) {
-  case lexer::TokenType::LET:
-    return parseLetStatement();
-  case lexer::TokenType::RETURN:
-    return parseReturnStatement();
-  default:
-    return parseExpressionStatement();
+ast::Ptr<ast::Statement> Parser::parseNextStatement() {
+  if (arena == nullptr) {
+    setArena(std::make_shared<ast::Arena>());
+    arena->retain(inputSource());
   }
-  return nullptr;
+  auto statement = parseStatement();
+  nextToken();
+  return statement;
 }
 
-std::unique_ptr<ast::LetStatement> Parser::parseLetStatement() {
-  auto letstatement = std::make_unique<ast::LetStatement>(curToken);
-  if (!expectPeek(lexer::TokenType::IDENT)) {
-    return nullptr;
+std::unique_ptr<ast::Program> Parser::parseProgram(unsigned threads,
+                                                   size_t minChunkTokens) {
+  if (tokens == nullptr) {
+    return parseProgram();
   }
-  letstatement->name = std::make_unique<ast::Identifier>(curToken);
-  if (!expectPeek(lexer::TokenType::ASSIGN)) {
-    return nullptr;
+  size_t begin = position();
+  size_t end = tokens->size() - 1; // the EOFILE token
+  size_t parts = std::max<size_t>(1, threads);
+  parts = std::min(parts,
+                   (end - begin) / std::max<size_t>(1, minChunkTokens));
+  if (parts <= 1) {
+    return parseProgram();
   }
-  nextToken();
-  letstatement->value = parseExpression(Precedence::LOWEST);
-  if (peekTokenIs(lexer::TokenType::SEMICOLON)) {
-    nextToken();
+  auto bounds = statementBounds(begin, end, parts);
+  if (bounds.size() <= 2) {
+    return parseProgram();
   }
-  return letstatement;
-}
 
-std::unique_ptr<ast::ReturnStatement> Parser::parseReturnStatement() {
-  auto returnStatement = std::make_unique<ast::ReturnStatement>(curToken);
-  nextToken();
-  returnStatement->returnValue = parseExpression(Precedence::LOWEST);
-  if (peekTokenIs(lexer::TokenType::SEMICOLON)) {
-    nextToken();
+  auto parse = [&](Parser &p, size_t stop, auto &&take) {
+    while (!p.atEnd() && p.position() < stop) {
+      auto statement = p.parseNextStatement();
+      if (statement != nullptr) {
+        take(std::move(statement));
+      }
+    }
+  };
+  std::vector<Part> results(bounds.size() - 1);
+  runOnThreads(results.size(), [&](size_t i) {
+    auto &part = results[i];
+    auto length = bounds[i + 1] - bounds[i];
+    part.arena = std::make_shared<ast::Arena>(
+        std::max<size_t>(4096, length * 32));
+    Parser p(tokens, bounds[i]);
+    p.setMaxDepth(maxDepth);
+    p.setMaxHeight(maxHeight);
+    p.setArena(part.arena);
+    parse(p, bounds[i + 1], [&](ast::Ptr<ast::Statement> statement) {
+      part.statements.push_back(std::move(statement));
+    });
+    part.errors = std::move(p.errors);
+    part.stop = p.position();
+  });
+
+  auto source = inputSource();
+  arena = std::make_shared<ast::Arena>();
+  arena->retain(source);
+  auto program = std::make_unique<ast::Program>(arena);
+  program->source = std::move(source);
+  size_t statements = 0;
+  for (const auto &part : results) {
+    statements += part.statements.size();
   }
-  return returnStatement;
+  program->statements.reserve(statements);
+  // The sequential parser's position so far; parts are taken only when it
+  // would have started a statement exactly at their first token.
+  size_t at = begin;
+  for (size_t i = 0; i < results.size(); i++) {
+    auto &part = results[i];
+    if (at == bounds[i]) {
+      arena->retain(part.arena);
+      for (auto &statement : part.statements) {
+        program->statements.push_back(std::move(statement));
+      }
+      errors.insert(errors.end(), part.errors.begin(), part.errors.end());
+      at = part.stop;
+      continue;
+    }
+    // The previous part's last statement ran past bounds[i], so this part
+    // was parsed from the wrong place; catch up sequentially.
+    Parser p(tokens, at);
+    p.setMaxDepth(maxDepth);
+    p.setMaxHeight(maxHeight);
+    p.setArena(arena);
+    parse(p, bounds[i + 1], [&](ast::Ptr<ast::Statement> statement) {
+      program->statements.push_back(std::move(statement));
+    });
+    errors.insert(errors.end(), p.errors.begin(), p.errors.end());
+    at = p.position();
+  }
+  // Leave this parser at EOFILE, as parseProgram() does.
+  tokenIndex = end;
+  nextToken();
+  nextToken();
+  return program;
 }
 
-std::unique_ptr<ast::ExpressionStatement> Parser::parseExpressionStatement() {
-  auto expressionStatement =
-      std::make_unique<ast::ExpressionStatement>(curToken);
-  expressionStatement->expression = parseExpression(Precedence::LOWEST);
-  if (peekTokenIs(lexer::TokenType::SEMICOLON)) {
-    nextToken();
+std::vector<size_t> Parser::statementBounds(size_t begin, size_t end,
+                                            size_t parts) const {
+  std::vector<size_t> bounds = {begin};
+  size_t depth = 0;
+  size_t part = 1;
+  for (size_t i = begin + 1; i < end && part < parts; i++) {
+    auto previous = tokens->type(i - 1);
+    switch (previous) {
+    case lexer::TokenType::LPAREN:
+    case lexer::TokenType::LBRACE:
+    case lexer::TokenType::LBRACKET:
+      depth++;
+      break;
+    case lexer::TokenType::RPAREN:
+    case lexer::TokenType::RBRACE:
+    case lexer::TokenType::RBRACKET:
+      depth -= depth > 0;
+      break;
+    default:
+      break;
+    }
+    if (i < begin + (end - begin) * part / parts || depth != 0) {
+      continue;
+    }
+    auto type = tokens->type(i);
+    if ((type == lexer::TokenType::LET || type == lexer::TokenType::RETURN) &&
+        (previous == lexer::TokenType::SEMICOLON ||
+         previous == lexer::TokenType::RBRACE)) {
+      bounds.push_back(i);
+      // Skip the nominal cuts this one already passed.
+      while (part < parts && i >= begin + (end - begin) * part / parts) {
+        part++;
+      }
+    }
   }
-  return expressionStatement;
+  bounds.push_back(end);
+  return bounds;
 }
 
-Expression Parser::parseIfExpression() {
-  auto expression = std::make_unique<ast::IfExpression>(curToken);
-  if (!expectPeek(lexer::TokenType::LPAREN)) {
+lexer::SourcePtr Parser::inputSource() const {
+  if (stream) {
     return nullptr;
   }
-  nextToken();
-  expression->condition = parseExpression(Precedence::LOWEST);
-  if (!expectPeek(lexer::TokenType::RPAREN)) {
-    return nullptr;
-  }
-  if (!expectPeek(lexer::TokenType::LBRACE)) {
-    return nullptr;
+  return l ? l->source() : tokens ? tokens->source() : pipeline->source();
+}
+
+// Makes a new arena keep the windows of the tokens the parser holds; the
+// ones after them are retained by nextToken.
+void Parser::retainWindows() {
+  if (stream) {
+    arena->retain(curWindow);
+    arena->retain(peekWindow);
   }
-  expression->consequence = parseBlockStatement();
-  if (peekTokenIs(lexer::TokenType::ELSE)) {
+}
+
+void Parser::setArena(std::shared_ptr<ast::Arena> arena) {
+  this->arena = std::move(arena);
+  retainWindows();
+}
+
+// A Pratt parser run on an explicit stack. Where a recursive descent parser
+// would call itself for a sub-construct, this pushes a frame recording what
+// the current construct waits for, and pops it when the sub-construct is
+// done, so the tree comes out the same, errors included.
+ast::Ptr<ast::Statement> Parser::parseStatement() {
+  using lexer::TokenType;
+  stack.clear();
+  auto step = Step::STATEMENT;
+  // Minimum binding power of the expression Step::EXPRESSION starts.
+  auto precedence = Precedence::LOWEST;
+  // The construct just finished; null after an error.
+  ast::Node *result = nullptr;
+  // Levels of the tree under result, itself included; 0 for null.
+  size_t height = 0;
+  auto push = [&](Pending pending, ast::Node *node,
+                  Precedence precedence = Precedence::LOWEST,
+                  size_t childHeight = 0) {
+    if (stack.size() >= maxDepth) {
+      return false;
+    }
+    stack.push_back(
+        {pending, precedence, static_cast<uint32_t>(childHeight), node});
+    return true;
+  };
+  // Hands the node of the frame on top on as the result, once all its
+  // children are in.
+  auto finish = [&]() {
+    result = stack.back().node;
+    height = stack.back().height + 1;
+    stack.pop_back();
+  };
+  // Records result as a child of the node of the frame on top.
+  auto adoptHeight = [&]() {
+    auto &top = stack.back();
+    top.height = std::max<uint32_t>(top.height, static_cast<uint32_t>(height));
+  };
+  // Starts an argument or element list, with curToken on its opening
+  // bracket; childHeight is that of the callee.
+  auto startList = [&](ast::Node *node, Pending pending, TokenType end,
+                       size_t childHeight) {
+    if (peekTokenIs(end)) {
+      nextToken();
+      result = node;
+      height = childHeight + 1;
+      step = Step::EXPRESSION_DONE;
+      return true;
+    }
     nextToken();
-    if (!expectPeek(lexer::TokenType::LBRACE)) {
-      return nullptr;
+    precedence = Precedence::LOWEST;
+    step = Step::EXPRESSION;
+    return push(pending, node, Precedence::LOWEST, childHeight);
+  };
+  // With curToken after a block statement, either parses the next one or
+  // closes the block.
+  auto continueBlock = [&]() {
+    if (curTokenIs(TokenType::RBRACE) || curTokenIs(TokenType::EOFILE)) {
+      finish();
+      step = Step::BLOCK_DONE;
+    } else {
+      step = Step::STATEMENT;
+    }
+  };
+
+  while (true) {
+    switch (step) {
+    case Step::STATEMENT: {
+      if (curTokenIs(TokenType::LET)) {
+        auto let = arena->make<ast::LetStatement>(curToken).release();
+        if (!expectPeek(TokenType::IDENT)) {
+          result = nullptr;
+          height = 0;
+          step = Step::STATEMENT_DONE;
+          break;
+        }
+        let->name = arena->make<ast::Identifier>(curToken);
+        if (!expectPeek(TokenType::ASSIGN)) {
+          result = nullptr;
+          height = 0;
+          step = Step::STATEMENT_DONE;
+          break;
+        }
+        nextToken();
+        if (!push(Pending::LET_VALUE, let, Precedence::LOWEST, 1)) {
+          return abandonStatement(Pending::LET_VALUE);
+        }
+      } else if (curTokenIs(TokenType::RETURN)) {
+        auto ret = arena->make<ast::ReturnStatement>(curToken).release();
+        nextToken();
+        if (!push(Pending::RETURN_VALUE, ret)) {
+          return abandonStatement(Pending::RETURN_VALUE);
+        }
+      } else {
+        auto statement =
+            arena->make<ast::ExpressionStatement>(curToken).release();
+        if (!push(Pending::EXPRESSION_STATEMENT, statement)) {
+          return abandonStatement(Pending::EXPRESSION_STATEMENT);
+        }
+      }
+      precedence = Precedence::LOWEST;
+      step = Step::EXPRESSION;
+      break;
+    }
+
+    case Step::EXPRESSION: {
+      // The prefix part of an expression; Step::EXPRESSION_DONE on the
+      // EXPRESSION frame then takes the infix operators after it.
+      if (curTokenIs(TokenType::ILLEGAL)) {
+        // Reported with what the lexer found wrong; like a token no
+        // expression starts with, it leaves the expression without a
+        // result rather than a left operand for the operators after it.
+        parseIllegal();
+        result = nullptr;
+        height = 0;
+        step = Step::EXPRESSION_DONE;
+        break;
+      }
+      if (!startsExpression(curToken.type)) {
+        noPrefixParseFnError(curToken.type);
+        result = nullptr;
+        height = 0;
+        step = Step::EXPRESSION_DONE;
+        break;
+      }
+      if (!push(Pending::EXPRESSION, nullptr, precedence)) {
+        return abandonStatement(Pending::EXPRESSION);
+      }
+      step = Step::EXPRESSION_DONE;
+      // Literals and identifiers; anything else replaces it.
+      height = 1;
+      switch (curToken.type) {
+      case TokenType::IDENT:
+        result = parseIdentifier().release();
+        break;
+      case TokenType::INT:
+        result = parseIntegerLiteral().release();
+        break;
+      case TokenType::TRUE:
+      case TokenType::FALSE:
+        result = parseBoolean().release();
+        break;
+      case TokenType::STRING:
+        result = parseStringLiteral().release();
+        break;
+      case TokenType::BANG:
+      case TokenType::MINUS: {
+        auto prefix = arena->make<ast::PrefixExpression>(curToken).release();
+        nextToken();
+        if (!push(Pending::PREFIX_RIGHT, prefix)) {
+          return abandonStatement(Pending::PREFIX_RIGHT);
+        }
+        precedence = Precedence::PREFIX;
+        step = Step::EXPRESSION;
+        break;
+      }
+      case TokenType::LPAREN:
+        nextToken();
+        if (!push(Pending::GROUP, nullptr)) {
+          return abandonStatement(Pending::GROUP);
+        }
+        precedence = Precedence::LOWEST;
+        step = Step::EXPRESSION;
+        break;
+      case TokenType::IF: {
+        auto expression = arena->make<ast::IfExpression>(curToken).release();
+        result = nullptr;
+        height = 0;
+        if (!expectPeek(TokenType::LPAREN)) {
+          break;
+        }
+        nextToken();
+        if (!push(Pending::IF_CONDITION, expression)) {
+          return abandonStatement(Pending::IF_CONDITION);
+        }
+        precedence = Precedence::LOWEST;
+        step = Step::EXPRESSION;
+        break;
+      }
+      case TokenType::FUNCTION: {
+        auto function = arena->make<ast::FunctionLiteral>(curToken).release();
+        result = nullptr;
+        height = 0;
+        if (!expectPeek(TokenType::LPAREN)) {
+          break;
+        }
+        function->parameters = parseFunctionParameters();
+        if (!expectPeek(TokenType::LBRACE)) {
+          break;
+        }
+        if (!push(Pending::FUNCTION_BODY, function)) {
+          return abandonStatement(Pending::FUNCTION_BODY);
+        }
+        step = Step::BLOCK;
+        break;
+      }
+      case TokenType::LBRACKET: {
+        auto array = arena->make<ast::ArrayLiteral>(curToken).release();
+        if (!startList(array, Pending::ARRAY_ELEMENTS, TokenType::RBRACKET,
+                       0)) {
+          return abandonStatement(Pending::ARRAY_ELEMENTS);
+        }
+        break;
+      }
+      default:
+        break;
+      }
+      break;
+    }
+
+    case Step::BLOCK: {
+      auto block = arena->make<ast::BlockStatement>(curToken).release();
+      nextToken();
+      if (!push(Pending::BLOCK, block)) {
+        return abandonStatement(Pending::BLOCK);
+      }
+      continueBlock();
+      break;
+    }
+
+    case Step::STATEMENT_DONE: {
+      if (stack.empty()) {
+        // Operator chains such as `1 + 1 + ... + 1` deepen the tree without
+        // deepening the parse, so the tree is measured as well.
+        if (height > maxHeight) {
+          heightError();
+          return nullptr;
+        }
+        return adopt<ast::Statement>(result);
+      }
+      // Only blocks contain statements.
+      auto block = static_cast<ast::BlockStatement *>(stack.back().node);
+      if (result != nullptr) {
+        block->statements.push_back(adopt<ast::Statement>(result));
+        adoptHeight();
+      }
+      nextToken();
+      continueBlock();
+      break;
+    }
+
+    case Step::EXPRESSION_DONE: {
+      auto &top = stack.back();
+      switch (top.pending) {
+      case Pending::LET_VALUE:
+      case Pending::RETURN_VALUE:
+      case Pending::EXPRESSION_STATEMENT:
+        if (top.pending == Pending::LET_VALUE) {
+          static_cast<ast::LetStatement *>(top.node)->value =
+              adopt<ast::Expression>(result);
+        } else if (top.pending == Pending::RETURN_VALUE) {
+          static_cast<ast::ReturnStatement *>(top.node)->returnValue =
+              adopt<ast::Expression>(result);
+        } else {
+          static_cast<ast::ExpressionStatement *>(top.node)->expression =
+              adopt<ast::Expression>(result);
+        }
+        if (peekTokenIs(TokenType::SEMICOLON)) {
+          nextToken();
+        }
+        adoptHeight();
+        finish();
+        step = Step::STATEMENT_DONE;
+        break;
+      case Pending::EXPRESSION: {
+        if (peekTokenIs(TokenType::SEMICOLON) ||
+            top.precedence >= peekPrecedence()) {
+          stack.pop_back();
+          break;
+        }
+        // Every token with a precedence above LOWEST is an infix operator.
+        nextToken();
+        if (curTokenIs(TokenType::LPAREN)) {
+          auto call = arena->make<ast::CallExpression>(curToken).release();
+          call->function = adopt<ast::Expression>(result);
+          if (!startList(call, Pending::CALL_ARGUMENTS, TokenType::RPAREN,
+                         height)) {
+            return abandonStatement(Pending::CALL_ARGUMENTS);
+          }
+          break;
+        }
+        auto infix = arena->make<ast::InfixExpression>(curToken).release();
+        infix->left = adopt<ast::Expression>(result);
+        precedence = curPrecedence();
+        nextToken();
+        if (!push(Pending::INFIX_RIGHT, infix, Precedence::LOWEST, height)) {
+          return abandonStatement(Pending::INFIX_RIGHT);
+        }
+        step = Step::EXPRESSION;
+        break;
+      }
+      case Pending::PREFIX_RIGHT:
+        static_cast<ast::PrefixExpression *>(top.node)->right =
+            adopt<ast::Expression>(result);
+        adoptHeight();
+        finish();
+        break;
+      case Pending::INFIX_RIGHT:
+        static_cast<ast::InfixExpression *>(top.node)->right =
+            adopt<ast::Expression>(result);
+        adoptHeight();
+        finish();
+        break;
+      case Pending::GROUP:
+        stack.pop_back();
+        if (!expectPeek(TokenType::RPAREN)) {
+          result = nullptr;
+          height = 0;
+        }
+        break;
+      case Pending::IF_CONDITION:
+        static_cast<ast::IfExpression *>(top.node)->condition =
+            adopt<ast::Expression>(result);
+        adoptHeight();
+        if (!expectPeek(TokenType::RPAREN) ||
+            !expectPeek(TokenType::LBRACE)) {
+          result = nullptr;
+          height = 0;
+          stack.pop_back();
+          break;
+        }
+        top.pending = Pending::IF_CONSEQUENCE;
+        step = Step::BLOCK;
+        break;
+      case Pending::ARRAY_ELEMENTS:
+      case Pending::CALL_ARGUMENTS: {
+        bool array = top.pending == Pending::ARRAY_ELEMENTS;
+        auto &list =
+            array ? static_cast<ast::ArrayLiteral *>(top.node)->elements
+                  : static_cast<ast::CallExpression *>(top.node)->arguments;
+        list.push_back(adopt<ast::Expression>(result));
+        adoptHeight();
+        if (peekTokenIs(TokenType::COMMA)) {
+          nextToken();
+          nextToken();
+          precedence = Precedence::LOWEST;
+          step = Step::EXPRESSION;
+          break;
+        }
+        if (!expectPeek(array ? TokenType::RBRACKET : TokenType::RPAREN)) {
+          list.clear();
+        }
+        finish();
+        break;
+      }
+      default:
+        break;
+      }
+      break;
+    }
+
+    case Step::BLOCK_DONE: {
+      auto &top = stack.back();
+      step = Step::EXPRESSION_DONE;
+      adoptHeight();
+      if (top.pending == Pending::FUNCTION_BODY) {
+        static_cast<ast::FunctionLiteral *>(top.node)->body =
+            adopt<ast::BlockStatement>(result);
+      } else if (top.pending == Pending::IF_ALTERNATIVE) {
+        static_cast<ast::IfExpression *>(top.node)->alternative =
+            adopt<ast::BlockStatement>(result);
+      } else {
+        static_cast<ast::IfExpression *>(top.node)->consequence =
+            adopt<ast::BlockStatement>(result);
+        if (peekTokenIs(TokenType::ELSE)) {
+          nextToken();
+          if (!expectPeek(TokenType::LBRACE)) {
+            result = nullptr;
+            height = 0;
+            stack.pop_back();
+            break;
+          }
+          top.pending = Pending::IF_ALTERNATIVE;
+          step = Step::BLOCK;
+          break;
+        }
+      }
+      finish();
+      break;
+    }
     }
-    expression->alternative = parseBlockStatement();
   }
-  return expression;
 }
 
-std::unique_ptr<ast::BlockStatement> Parser::parseBlockStatement() {
-  auto blockStatement = std::make_unique<ast::BlockStatement>(curToken);
-  nextToken();
-  while (!curTokenIs(lexer::TokenType::RBRACE) &&
-         !curTokenIs(lexer::TokenType::EOFILE)) {
-    auto statement = parseStatement();
-    if (statement != nullptr) {
-      blockStatement->statements.push_back(std::move(statement));
+// Reports a statement nested deeper than maxDepth and skips the rest of it:
+// up to the `;` or the start of the next statement once every bracket it
+// opened is closed again. failed is the frame that did not fit; its
+// opening bracket, if any, is already behind curToken.
+ast::Ptr<ast::Statement> Parser::abandonStatement(Pending failed) {
+  depthError();
+  auto opensBracket = [](Pending pending) {
+    return pending == Pending::GROUP || pending == Pending::IF_CONDITION ||
+           pending == Pending::BLOCK || pending == Pending::ARRAY_ELEMENTS ||
+           pending == Pending::CALL_ARGUMENTS;
+  };
+  size_t depth = std::count_if(
+      stack.begin(), stack.end(),
+      [&](const Frame &frame) { return opensBracket(frame.pending); });
+  depth += opensBracket(failed);
+  stack.clear();
+  while (!curTokenIs(lexer::TokenType::EOFILE)) {
+    switch (curToken.type) {
+    case lexer::TokenType::LPAREN:
+    case lexer::TokenType::LBRACE:
+    case lexer::TokenType::LBRACKET:
+      depth++;
+      break;
+    case lexer::TokenType::RPAREN:
+    case lexer::TokenType::RBRACE:
+    case lexer::TokenType::RBRACKET:
+      depth -= depth > 0;
+      break;
+    default:
+      break;
+    }
+    if (depth == 0 && (curTokenIs(lexer::TokenType::SEMICOLON) ||
+                       peekTokenIs(lexer::TokenType::LET) ||
+                       peekTokenIs(lexer::TokenType::RETURN) ||
+                       peekTokenIs(lexer::TokenType::EOFILE))) {
+      break;
     }
     nextToken();
   }
-  return blockStatement;
+  return nullptr;
+}
+
+void Parser::depthError() {
+  errors.push_back("nesting exceeds the maximum depth of " +
+                   std::to_string(maxDepth));
+}
+
+void Parser::heightError() {
+  errors.push_back("expression tree exceeds the maximum height of " +
+                   std::to_string(maxHeight));
 }
 
 void Parser::noPrefixParseFnError(lexer::TokenType type) {
@@ -143,87 +723,56 @@ void Parser::noPrefixParseFnError(lexer::TokenType type) {
   errors.push_back(msg);
 }
 
-Expression Parser::parseExpression(Precedence precedence) {
-  auto prefix = prefixParseFns[curToken.type];
-  if (prefix == nullptr) {
-    noPrefixParseFnError(curToken.type);
-    return nullptr;
-  }
-  auto leftExp = prefix();
-
-  while (not peekTokenIs(lexer::TokenType::SEMICOLON) and
-         precedence < peekPrecedence()) {
-    auto infix = infixParseFns[peekToken.type];
-    if (infix == nullptr) {
-      return leftExp;
-    }
-    nextToken();
-    leftExp = infix(std::move(leftExp));
-  }
-  return leftExp;
-}
-
 Expression Parser::parseIdentifier() {
-  return std::make_unique<ast::Identifier>(curToken);
+  return arena->make<ast::Identifier>(curToken);
 }
 
 Expression Parser::parseIntegerLiteral() {
-  auto literal = std::make_unique<ast::IntegerLiteral>(curToken);
-  int value = 0;
-  try {
-    value = std::stoi(curToken.literal);
-  } catch (std::invalid_argument &e) {
-    std::string msg = "could not parse " + curToken.literal + " as integer";
-    errors.push_back(msg);
-    return nullptr;
-  }
-  literal->value = value;
+  auto literal = arena->make<ast::IntegerLiteral>(curToken);
+  literal->value = curToken.payload;
   return literal;
 }
 
-Expression Parser::parsePrefixExpression() {
-  auto expression = std::make_unique<ast::PrefixExpression>(curToken);
-  nextToken();
-  expression->right = parseExpression(Precedence::PREFIX);
-  return expression;
-}
-
-Expression Parser::parseInfixExpression(Expression left) {
-  auto expression = std::make_unique<ast::InfixExpression>(curToken);
-  expression->left = std::move(left);
-  auto precedence = curPrecedence();
-  nextToken();
-  expression->right = parseExpression(precedence);
-  return expression;
+Expression Parser::parseIllegal() {
+  std::string literal(curToken.literal);
+  switch (static_cast<lexer::LexError>(curToken.payload)) {
+  case lexer::LexError::MALFORMED_NUMBER:
+    errors.push_back("could not parse " + literal + " as integer");
+    break;
+  case lexer::LexError::NUMBER_OUT_OF_RANGE:
+    errors.push_back("integer literal " + literal +
+                     " does not fit in 64 bits");
+    break;
+  case lexer::LexError::UNEXPECTED_CHARACTER:
+    noPrefixParseFnError(curToken.type);
+    break;
+  case lexer::LexError::INVALID_UTF8:
+    errors.push_back(literal.front() == '"'
+                         ? "string literal " + literal + " is not valid UTF-8"
+                         : std::string("invalid UTF-8 byte sequence"));
+    break;
+  }
+  return nullptr;
 }
 
 Expression Parser::parseBoolean() {
-  return std::make_unique<ast::Boolean>(curToken,
+  return arena->make<ast::Boolean>(curToken,
                                         curTokenIs(lexer::TokenType::TRUE));
 }
 
-Expression Parser::parseGroupedExpression() {
-  nextToken();
-  auto exp = parseExpression(Precedence::LOWEST);
-  if (!expectPeek(lexer::TokenType::RPAREN)) {
-    return nullptr;
-  }
-  return exp;
-}
-
 ast::Parameters Parser::parseFunctionParameters() {
-  ast::Parameters parameters;
+  ast::Parameters parameters(arena->allocator());
   if (peekTokenIs(lexer::TokenType::RPAREN)) {
     nextToken();
     return parameters;
   }
   nextToken();
-  auto identifier = std::make_unique<ast::Identifier>(curToken);
+  auto identifier = arena->make<ast::Identifier>(curToken);
   parameters.push_back(std::move(identifier));
   while (peekTokenIs(lexer::TokenType::COMMA)) {
     nextToken();
     nextToken();
-    auto identifier = std::make_unique<ast::Identifier>(curToken);
+    auto identifier = arena->make<ast::Identifier>(curToken);
     parameters.push_back(std::move(identifier));
   }
   if (!expectPeek(lexer::TokenType::RPAREN)) {
@@ -232,53 +781,8 @@ ast::Parameters Parser::parseFunctionParameters() {
   return parameters;
 }
 
-Expression Parser::parseFunctionLiteral() {
-  auto functionLiteral = std::make_unique<ast::FunctionLiteral>(curToken);
-  if (!expectPeek(lexer::TokenType::LPAREN)) {
-    return nullptr;
-  }
-  functionLiteral->parameters = parseFunctionParameters();
-  if (!expectPeek(lexer::TokenType::LBRACE)) {
-    return nullptr;
-  }
-  functionLiteral->body = parseBlockStatement();
-  return functionLiteral;
-}
-
-Expression Parser::parseCallExpression(Expression function) {
-  auto expression = std::make_unique<ast::CallExpression>(curToken);
-  expression->function = std::move(function);
-  expression->arguments = parseExpressionList(lexer::TokenType::RPAREN);
-  return expression;
-}
-
 Expression Parser::parseStringLiteral() {
-  return std::make_unique<ast::StringLiteral>(curToken);
-}
-
-Expression Parser::parseArrayLiteral() {
-  auto arrayLiteral = std::make_unique<ast::ArrayLiteral>(curToken);
-  arrayLiteral->elements = parseExpressionList(lexer::TokenType::RBRACKET);
-  return arrayLiteral;
-}
-
-ast::Arguments Parser::parseExpressionList(lexer::TokenType end) {
-  ast::Arguments list;
-  if (peekTokenIs(end)) {
-    nextToken();
-    return list;
-  }
-  nextToken();
-  list.push_back(parseExpression(Precedence::LOWEST));
-  while (peekTokenIs(lexer::TokenType::COMMA)) {
-    nextToken(); // skip comma
-    nextToken();
-    list.push_back(parseExpression(Precedence::LOWEST));
-  }
-  if (!expectPeek(end)) {
-    return {};
-  }
-  return list;
+  return arena->make<ast::StringLiteral>(curToken);
 }
 
 bool Parser::curTokenIs(lexer::TokenType type) { return curToken.type == type; }
@@ -305,28 +809,12 @@ void Parser::peekError(lexer::TokenType type) {
   errors.push_back(msg);
 }
 
-void Parser::registerPrefix(lexer::TokenType type, auto fn) {
-  prefixParseFns[type] = std::bind(fn, this);
-}
-
-void Parser::registerInfix(lexer::TokenType type, auto fn) {
-  infixParseFns[type] = std::bind(fn, this, std::placeholders::_1);
-}
-
 Precedence Parser::peekPrecedence() {
-  auto it = precedences.find(peekToken.type);
-  if (it != precedences.end()) {
-    return it->second;
-  }
-  return Precedence::LOWEST;
+  return precedences[static_cast<size_t>(peekToken.type)];
 }
 
 Precedence Parser::curPrecedence() {
-  auto it = precedences.find(curToken.type);
-  if (it != precedences.end()) {
-    return it->second;
-  }
-  return Precedence::LOWEST;
+  return precedences[static_cast<size_t>(curToken.type)];
 }
 
 } // namespace parser
@@ -1,21 +1,21 @@
 #pragma once
 
 #include "../lexer/lexer.hpp"
+#include "../lexer/pipelined_lexer.hpp"
+#include "../lexer/stream_lexer.hpp"
+#include "arena.hpp"
 #include "ast.hpp"
-#include <functional>
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 namespace monkey {
 namespace parser {
 class Parser;
 
-using PrefixParseFn = std::function<std::unique_ptr<ast::Expression>()>;
-using InfixParseFn = std::function<std::unique_ptr<ast::Expression>(
-    std::unique_ptr<ast::Expression>)>;
-using Expression = std::unique_ptr<ast::Expression>;
+using Expression = ast::Ptr<ast::Expression>;
 using Errors = std::vector<std::string>;
 
 enum class Precedence {
@@ -29,50 +29,131 @@ enum class Precedence {
   INDEX        // array[index]
 };
 
-const std::unordered_map<lexer::TokenType, Precedence> precedences = {
-    {lexer::TokenType::EQ, Precedence::EQUALS},
-    {lexer::TokenType::NOT_EQ, Precedence::EQUALS},
-    {lexer::TokenType::LT, Precedence::LESSGREATER},
-    {lexer::TokenType::GT, Precedence::LESSGREATER},
-    {lexer::TokenType::PLUS, Precedence::SUM},
-    {lexer::TokenType::MINUS, Precedence::SUM},
-    {lexer::TokenType::SLASH, Precedence::PRODUCT},
-    {lexer::TokenType::ASTERISK, Precedence::PRODUCT},
-    {lexer::TokenType::LPAREN, Precedence::CALL},
-};
+constexpr std::array<Precedence, lexer::TOKEN_TYPE_COUNT> makePrecedences() {
+  std::array<Precedence, lexer::TOKEN_TYPE_COUNT> table{};
+  auto set = [&](lexer::TokenType type, Precedence precedence) {
+    table[static_cast<size_t>(type)] = precedence;
+  };
+  set(lexer::TokenType::EQ, Precedence::EQUALS);
+  set(lexer::TokenType::NOT_EQ, Precedence::EQUALS);
+  set(lexer::TokenType::LT, Precedence::LESSGREATER);
+  set(lexer::TokenType::GT, Precedence::LESSGREATER);
+  set(lexer::TokenType::PLUS, Precedence::SUM);
+  set(lexer::TokenType::MINUS, Precedence::SUM);
+  set(lexer::TokenType::SLASH, Precedence::PRODUCT);
+  set(lexer::TokenType::ASTERISK, Precedence::PRODUCT);
+  set(lexer::TokenType::LPAREN, Precedence::CALL);
+  return table;
+}
+
+// Binding power of each token type when it follows an expression; LOWEST
+// for tokens that are not infix operators.
+inline constexpr std::array<Precedence, lexer::TOKEN_TYPE_COUNT> precedences =
+    makePrecedences();
 
 class Parser {
 public:
   explicit Parser(lexer::Lexer *l);
+  // Parses a pre-lexed stream from token begin on; the stream must outlive
+  // the parser.
+  explicit Parser(const lexer::TokenStream *tokens, size_t begin = 0);
+  // Parses while the lexer produces tokens on its own thread.
+  explicit Parser(lexer::PipelinedLexer *pipeline);
+  // Parses while the lexer reads its input. The windows the tokens point
+  // into are kept alive by the arena of the nodes made from them; since
+  // there is no single source text, the program's source is null.
+  explicit Parser(lexer::StreamLexer *stream);
   ~Parser() = default;
 
+  // Nesting is tracked on a stack of its own rather than the C++ stack.
+  // Each construct still open at a point of the parse -- statement, block,
+  // bracket, or operator waiting for its operand -- takes one level. A
+  // statement that would go deeper is reported as an error and skipped.
+  static constexpr size_t kDefaultMaxDepth = 2048;
+  void setMaxDepth(size_t depth) { maxDepth = depth; }
+  // Chains of left-associative operators, e.g. `1 + 1 + ... + 1` or
+  // `f()()...()`, build tall trees without deepening the parse, so the
+  // height of each statement's tree has a limit of its own: a statement
+  // with more levels is an error. The tree walkers -- evaluator, printer,
+  // optimizer, flattener -- recurse once per level; the flattener, the
+  // hungriest, overflows an 8 MiB stack at about 12000 levels in an
+  // unoptimised build.
+  static constexpr size_t kDefaultMaxHeight = 8192;
+  void setMaxHeight(size_t height) { maxHeight = height; }
+
   void nextToken();
   std::unique_ptr<ast::Program> parseProgram();
+  // Parses the rest of a pre-lexed stream on up to `threads` threads and
+  // returns what parseProgram() would, errors included.
+  //
+  // A pre-pass over the token types cuts the stream into roughly equal
+  // parts, each starting at a `let` or `return` at bracket depth 0 right
+  // after a `;` or `}` -- where a top-level statement almost always starts.
+  // Parts are parsed concurrently into arenas of their own. While merging,
+  // a part is only taken if the previous one ended exactly where it
+  // begins; otherwise its statements are parsed again from where the
+  // previous one really ended, so a wrong guess costs time, not
+  // correctness. Streams below threads * minChunkTokens, and parsers not
+  // reading a TokenStream, use parseProgram().
+  std::unique_ptr<ast::Program> parseProgram(unsigned threads,
+                                             size_t minChunkTokens = 16384);
   Errors getErrors() const;
 
+  // Statement-at-a-time parsing, for callers that assemble a Program
+  // themselves. Parses the top-level statement at the current token and
+  // moves past it; null if the statement had errors. Nodes go into the
+  // arena given to setArena, or a fresh one.
+  ast::Ptr<ast::Statement> parseNextStatement();
+  bool atEnd() const { return curToken.type == lexer::TokenType::EOFILE; }
+  // Index of the current token in the stream being parsed.
+  size_t position() const { return tokenIndex - 2; }
+  void setArena(std::shared_ptr<ast::Arena> arena);
+
 private:
-  std::unique_ptr<ast::Statement> parseStatement();
-  std::unique_ptr<ast::LetStatement> parseLetStatement();
-  std::unique_ptr<ast::ReturnStatement> parseReturnStatement();
-  std::unique_ptr<ast::ExpressionStatement> parseExpressionStatement();
-  std::unique_ptr<ast::BlockStatement> parseBlockStatement();
+  // What a frame of the parse stack is waiting for.
+  enum class Pending : uint8_t {
+    LET_VALUE,            // the value of a let statement
+    RETURN_VALUE,         // the value of a return statement
+    EXPRESSION_STATEMENT, // the expression of an expression statement
+    EXPRESSION,           // an operand, which infix operators may follow
+    PREFIX_RIGHT,         // the operand of a prefix operator
+    INFIX_RIGHT,          // the right operand of an infix operator
+    GROUP,                // the expression inside parentheses
+    IF_CONDITION,
+    IF_CONSEQUENCE,
+    IF_ALTERNATIVE,
+    FUNCTION_BODY,
+    BLOCK,                // the next statement of a block
+    ARRAY_ELEMENTS,       // the next element of an array literal
+    CALL_ARGUMENTS,       // the next argument of a call
+  };
+  struct Frame {
+    Pending pending;
+    // Binding power of the operators an EXPRESSION frame may still take.
+    Precedence precedence;
+    // Levels of the tallest child of node so far.
+    uint32_t height;
+    // The node being built; arena nodes, so not owned.
+    ast::Node *node;
+  };
+
+  ast::Ptr<ast::Statement> parseStatement();
+  ast::Ptr<ast::Statement> abandonStatement(Pending failed);
 
-  Expression parseExpression(Precedence precedence);
   Expression parseIdentifier();
   Expression parseIntegerLiteral();
-  Expression parsePrefixExpression();
-  Expression parseInfixExpression(Expression left);
+  Expression parseIllegal();
   Expression parseBoolean();
-  Expression parseGroupedExpression();
-  Expression parseIfExpression();
-  Expression parseFunctionLiteral();
-  ast::Parameters parseFunctionParameters();
-  Expression parseCallExpression(Expression function);
   Expression parseStringLiteral();
-  Expression parseArrayLiteral();
-  ast::Arguments parseExpressionList(lexer::TokenType end);
+  ast::Parameters parseFunctionParameters();
 
+  void depthError();
+  void heightError();
   void noPrefixParseFnError(lexer::TokenType type);
+  lexer::SourcePtr inputSource() const;
+  void retainWindows();
+  std::vector<size_t> statementBounds(size_t begin, size_t end,
+                                      size_t parts) const;
 
   Precedence peekPrecedence();
   Precedence curPrecedence();
@@ -81,15 +162,25 @@ private:
   bool curTokenIs(lexer::TokenType type);
   bool peekTokenIs(lexer::TokenType type);
   void peekError(lexer::TokenType type);
-  void registerPrefix(lexer::TokenType type, auto fn);
-  void registerInfix(lexer::TokenType type, auto fn);
 
-  lexer::Lexer *l;
+  lexer::Lexer *l = nullptr;
+  const lexer::TokenStream *tokens = nullptr;
+  lexer::PipelinedLexer *pipeline = nullptr;
+  lexer::StreamLexer *stream = nullptr;
+  // With a StreamLexer, the windows curToken and peekToken point into.
+  lexer::SourcePtr curWindow;
+  lexer::SourcePtr peekWindow;
+  // Where parseProgram allocates the nodes of the tree it is building.
+  std::shared_ptr<ast::Arena> arena;
+  size_t tokenIndex = 0;
   lexer::Token curToken;
   lexer::Token peekToken;
   Errors errors;
-  std::unordered_map<lexer::TokenType, PrefixParseFn> prefixParseFns;
-  std::unordered_map<lexer::TokenType, InfixParseFn> infixParseFns;
+  // Constructs parseStatement has open, innermost last; kept between
+  // statements so its storage is reused.
+  std::vector<Frame> stack;
+  size_t maxDepth = kDefaultMaxDepth;
+  size_t maxHeight = kDefaultMaxHeight;
 };
 
 } // namespace parser
@@ -0,0 +1,121 @@
+#include "resolver.hpp"
+#include "ast_walk.hpp"
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace monkey::parser {
+
+namespace {
+
+using ast::ExpressionType;
+using ast::StatementType;
+
+constexpr size_t kMaxIndex = std::numeric_limits<uint16_t>::max();
+
+class Resolver {
+public:
+  void resolve(ast::Statement *node) {
+    if (node == nullptr) {
+      return;
+    }
+    if (node->Type() == StatementType::LET) {
+      use(*static_cast<ast::LetStatement *>(node)->name);
+    }
+    ast::forEachChild(*node, [this](auto *child) { resolve(child); });
+  }
+
+  void resolve(ast::Expression *node) {
+    if (node == nullptr) {
+      return;
+    }
+    if (node->Type() == ExpressionType::IDENTIFIER) {
+      use(static_cast<ast::Identifier &>(*node));
+    } else if (node->Type() == ExpressionType::FUNCTION) {
+      function(static_cast<ast::FunctionLiteral &>(*node));
+    } else {
+      ast::forEachChild(*node, [this](auto *child) { resolve(child); });
+    }
+  }
+
+private:
+  struct Scope {
+    ast::FunctionLiteral *function;
+    std::unordered_map<lexer::Symbol, size_t> slots;
+  };
+
+  void function(ast::FunctionLiteral &fn) {
+    scopes_.push_back(Scope{&fn, {}});
+    auto &scope = scopes_.back();
+    fn.slots.clear();
+    for (auto &param : fn.parameters) {
+      declare(scope, param->symbol);
+    }
+    declareLets(scope, fn.body.get());
+    fn.resolved = fn.slots.size() <= kMaxIndex + 1;
+
+    for (auto &param : fn.parameters) {
+      use(*param);
+    }
+    resolve(fn.body.get());
+    scopes_.pop_back();
+  }
+
+  static void declare(Scope &scope, lexer::Symbol name) {
+    if (scope.slots.try_emplace(name, scope.function->slots.size()).second) {
+      scope.function->slots.push_back(name);
+    }
+  }
+
+  static void declareLets(Scope &scope, ast::Statement *node) {
+    if (node == nullptr) {
+      return;
+    }
+    if (node->Type() == StatementType::LET) {
+      declare(scope, static_cast<ast::LetStatement *>(node)->name->symbol);
+    }
+    ast::forEachChild(*node, [&](auto *child) { declareLets(scope, child); });
+  }
+
+  static void declareLets(Scope &scope, ast::Expression *node) {
+    // Nested functions bind names in environments of their own.
+    if (node != nullptr && node->Type() != ExpressionType::FUNCTION) {
+      ast::forEachChild(*node, [&](auto *child) { declareLets(scope, child); });
+    }
+  }
+
+  void use(ast::Identifier &identifier) {
+    identifier.binding = ast::Binding::DYNAMIC;
+    for (size_t depth = 0; depth < scopes_.size(); depth++) {
+      const auto &scope = scopes_[scopes_.size() - 1 - depth];
+      auto found = scope.slots.find(identifier.symbol);
+      if (found == scope.slots.end()) {
+        continue;
+      }
+      if (scope.function->resolved && depth <= kMaxIndex) {
+        identifier.binding = ast::Binding::LOCAL;
+        identifier.depth = static_cast<uint16_t>(depth);
+        identifier.slot = static_cast<uint16_t>(found->second);
+      }
+      return;
+    }
+    if (scopes_.size() <= kMaxIndex) {
+      identifier.binding = ast::Binding::GLOBAL;
+      identifier.depth = static_cast<uint16_t>(scopes_.size());
+    }
+  }
+
+  // Functions enclosing the node being resolved, innermost last.
+  std::vector<Scope> scopes_;
+};
+
+} // namespace
+
+void resolveScopes(ast::Statements &statements) {
+  Resolver resolver;
+  for (auto &statement : statements) {
+    resolver.resolve(statement.get());
+  }
+}
+
+} // namespace monkey::parser
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ast.hpp"
+
+namespace monkey::parser {
+
+// Works out where the binding of each identifier in statements lives, so
+// the evaluator can reach it without hashing names (see ast::Binding).
+//
+// Each function literal gets a slot for each of its parameters and each
+// name bound by a `let` anywhere in its body outside nested functions;
+// blocks share their function's environment, so they have no scope of
+// their own. An identifier bound by an enclosing function becomes LOCAL,
+// any other GLOBAL. Globals stay dynamic: the top level and the builtins
+// can be rebound by statements the resolver never sees, e.g. later lines
+// of the REPL.
+//
+// Reading a slot whose `let` has not run yet falls back to looking the name
+// up further out, which is what evaluation did before. Functions with more
+// slots, and identifiers further out, than the 16-bit fields hold are left
+// DYNAMIC. The result for a top-level statement only depends on that
+// statement, so statements shared between programs may be resolved again.
+void resolveScopes(ast::Statements &statements);
+
+} // namespace monkey::parser
@@ -0,0 +1,105 @@
+#include "statement_stream.hpp"
+#include <algorithm>
+
+namespace monkey::parser {
+
+namespace {
+// Most top-level statements are a line or two; larger ones grow the arena.
+constexpr size_t kStatementArenaBytes = 1024;
+} // namespace
+
+StatementStream::StatementStream(lexer::SourcePtr source, bool parseAhead,
+                                 size_t capacity)
+    : source_(source), lexer_(std::in_place, std::move(source)),
+      parser_(&*lexer_), ring_(parseAhead ? capacity : 0) {
+  start(parseAhead);
+}
+
+StatementStream::StatementStream(int fd, bool parseAhead, size_t capacity)
+    : streamLexer_(std::in_place, fd), parser_(&*streamLexer_),
+      ring_(parseAhead ? capacity : 0) {
+  start(parseAhead);
+}
+
+void StatementStream::start(bool parseAhead) {
+  if (parseAhead) {
+    buffer_.resize(std::min(kBatch, ring_.capacity()));
+    producer_ = std::thread(&StatementStream::produce, this);
+  }
+}
+
+StatementStream::~StatementStream() {
+  if (producer_.joinable()) {
+    stop_ = true;
+    ring_.cancel();
+    producer_.join();
+  }
+}
+
+bool StatementStream::next(ParsedStatement &out) {
+  if (!producer_.joinable()) {
+    return parseOne(out);
+  }
+  if (next_ == filled_) {
+    filled_ = ring_.pop(buffer_.data(), buffer_.size());
+    next_ = 0;
+    if (filled_ == 0) {
+      // The producer closed the ring; joining also publishes errors_.
+      producer_.join();
+      return false;
+    }
+  }
+  out = std::move(buffer_[next_++]);
+  return true;
+}
+
+bool StatementStream::parseOne(ParsedStatement &out) {
+  while (!parser_.atEnd() && errors_.empty()) {
+    auto arena = std::make_shared<ast::Arena>(kStatementArenaBytes);
+    if (source_ != nullptr) {
+      arena->retain(source_);
+    }
+    parser_.setArena(arena);
+    auto statement = parser_.parseNextStatement();
+    if (!parser_.getErrors().empty()) {
+      // Parse the rest only for its errors.
+      while (!parser_.atEnd() && !stop_) {
+        parser_.setArena(std::make_shared<ast::Arena>(kStatementArenaBytes));
+        parser_.parseNextStatement();
+      }
+      errors_ = parser_.getErrors();
+      return false;
+    }
+    if (statement != nullptr) {
+      out = {std::move(arena), statement.release()};
+      return true;
+    }
+  }
+  return false;
+}
+
+void StatementStream::produce() {
+  std::vector<ParsedStatement> pending(buffer_.size());
+  size_t count = 0;
+  bool first = true;
+  while (true) {
+    bool done = !parseOne(pending[count]);
+    count += !done;
+    // The first statement goes out alone, so running the script can start
+    // right away.
+    if (count == pending.size() || (first && count == 1) || done) {
+      if (!ring_.push(pending.data(), count)) {
+        return;
+      }
+      std::fill_n(pending.begin(), count, ParsedStatement());
+      count = 0;
+      first = false;
+    }
+    if (done) {
+      ring_.close();
+      return;
+    }
+  }
+}
+
+} // namespace monkey::parser
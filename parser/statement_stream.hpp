@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../lexer/lexer.hpp"
+#include "../lexer/source.hpp"
+#include "../lexer/spsc_ring.hpp"
+#include "../lexer/stream_lexer.hpp"
+#include "arena.hpp"
+#include "ast.hpp"
+#include "parser.hpp"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace monkey::parser {
+
+// A top-level statement and the arena holding its nodes; the statement
+// goes away with the last copy of arena.
+struct ParsedStatement {
+  std::shared_ptr<ast::Arena> arena;
+  ast::Statement *statement = nullptr;
+};
+
+// Hands out the top-level statements of a script as soon as each one is
+// parsed, so that a caller can start running the script before the rest
+// of it is parsed. Statements are parsed on demand, or with parseAhead on
+// a background thread that runs up to capacity statements ahead, handing
+// them over in batches after the first. Each
+// statement gets an arena of its own, so tree memory is bounded by what
+// the caller keeps rather than by the size of the script.
+//
+// The stream ends at the first statement with a parse error, which is not
+// handed out. The rest of the script is still parsed so that errors()
+// lists what Parser::parseProgram would report. Destroying the stream
+// early stops the background thread.
+class StatementStream {
+public:
+  static constexpr size_t kDefaultCapacity = 256;
+  static constexpr size_t kBatch = 32;
+
+  explicit StatementStream(lexer::SourcePtr source, bool parseAhead = false,
+                           size_t capacity = kDefaultCapacity);
+  // Reads the script from a file descriptor or pipe as it arrives (see
+  // StreamLexer), so statements can run before the input is complete.
+  explicit StatementStream(int fd, bool parseAhead = false,
+                           size_t capacity = kDefaultCapacity);
+  StatementStream(const StatementStream &) = delete;
+  StatementStream &operator=(const StatementStream &) = delete;
+  ~StatementStream();
+
+  // Moves the next statement into out; false once there is none.
+  bool next(ParsedStatement &out);
+  // Parse errors of the script, once next() has returned false.
+  const Errors &errors() const { return errors_; }
+
+private:
+  void start(bool parseAhead);
+  bool parseOne(ParsedStatement &out);
+  void produce();
+
+  // Null when reading a file descriptor.
+  lexer::SourcePtr source_;
+  // One of the two feeds parser_.
+  std::optional<lexer::Lexer> lexer_;
+  std::optional<lexer::StreamLexer> streamLexer_;
+  Parser parser_;
+  Errors errors_;
+  lexer::SpscRing<ParsedStatement> ring_;
+  // Consumer side: statements popped from the ring, not yet handed out.
+  std::vector<ParsedStatement> buffer_;
+  size_t next_ = 0;
+  size_t filled_ = 0;
+  std::atomic<bool> stop_{false};
+  std::thread producer_;
+};
+
+} // namespace monkey::parser
@@ -0,0 +1,148 @@
+// Compiles Monkey scripts to .mkc files on a pool of threads, so that
+// deployments can ship them and skip parsing at startup.
+// Usage: MonkeyPrecompile [-j threads] [-o output-dir] path...
+// Each path is a script or a directory searched recursively for *.mk files.
+// Without -o a script's .mkc is written next to it.
+#include "lexer/lexer.hpp"
+#include "parser/flat_ast.hpp"
+#include "parser/mkc.hpp"
+#include "parser/parser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace monkey;
+
+namespace {
+
+struct Job {
+  fs::path script;
+  fs::path output;
+  // Filled in by the worker: empty on success.
+  std::string failure;
+};
+
+std::string compile(const Job &job) {
+  try {
+    auto source = lexer::Source::mapFile(job.script.string());
+    lexer::Lexer l(source);
+    parser::Parser p(&l);
+    auto program = p.parseProgram();
+    auto errors = p.getErrors();
+    if (!errors.empty()) {
+      std::string failure;
+      for (size_t i = 0; i < std::min<size_t>(errors.size(), 10); i++) {
+        failure += "\n\t" + errors[i];
+      }
+      if (errors.size() > 10) {
+        failure += "\n\t... and " + std::to_string(errors.size() - 10) +
+                   " more errors";
+      }
+      return failure;
+    }
+    fs::create_directories(job.output.parent_path());
+    parser::mkc::write(job.output.string(), parser::flat::flatten(*program));
+  } catch (const std::exception &e) {
+    return std::string(" ") + e.what();
+  }
+  return "";
+}
+
+int usage() {
+  std::cerr << "usage: MonkeyPrecompile [-j threads] [-o output-dir] path..."
+            << std::endl;
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  fs::path outputDir;
+  std::vector<fs::path> inputs;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "-j" || arg == "-o") && i + 1 == argc) {
+      return usage();
+    }
+    if (arg == "-j") {
+      threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "-o") {
+      outputDir = argv[++i];
+    } else {
+      inputs.emplace_back(arg);
+    }
+  }
+  if (inputs.empty()) {
+    return usage();
+  }
+
+  std::vector<Job> jobs;
+  auto add = [&](const fs::path &script, const fs::path &root) {
+    auto output = script;
+    if (!outputDir.empty()) {
+      output = outputDir / script.lexically_relative(root);
+    }
+    output.replace_extension(parser::mkc::EXTENSION);
+    jobs.push_back({script, output, ""});
+  };
+  try {
+    for (const auto &input : inputs) {
+      if (!fs::is_directory(input)) {
+        add(input, input.parent_path());
+        continue;
+      }
+      for (const auto &entry : fs::recursive_directory_iterator(input)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".mk") {
+          add(entry.path(), input);
+        }
+      }
+    }
+  } catch (const fs::filesystem_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  // Largest first, so one big script does not start last and run alone.
+  std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) {
+    std::error_code ignored;
+    return fs::file_size(a.script, ignored) > fs::file_size(b.script, ignored);
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  threads = std::min<size_t>(threads, std::max<size_t>(jobs.size(), 1));
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      for (size_t i; (i = next.fetch_add(1)) < jobs.size();) {
+        jobs[i].failure = compile(jobs[i]);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t failed = 0;
+  for (const auto &job : jobs) {
+    if (!job.failure.empty()) {
+      failed++;
+      std::cerr << job.script.string() << ":" << job.failure << std::endl;
+    }
+  }
+  std::cout << "compiled " << jobs.size() - failed << " of " << jobs.size()
+            << " scripts on " << threads << " threads in "
+            << elapsed.count() * 1e3 << " ms" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
@@ -1,12 +1,32 @@
 #include "lexer/lexer.hpp"
+#include "lexer/stream_lexer.hpp"
 #include "lexer/token.hpp"
+#include "parser/mkc.hpp"
+#include "parser/optimizer.hpp"
 #include "parser/parser.hpp"
+#include "parser/statement_stream.hpp"
 #include "eval/evaluator.hpp"
 
+#include <filesystem>
 #include <iostream>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
 #include <version.hpp>
 
 constexpr auto PROMPT = ">> ";
+// Script name that reads the script from standard input, e.g. a pipe.
+constexpr std::string_view STDIN_SCRIPT = "-";
+
+// Set from the command line.
+struct Options {
+  int level = 1;
+  // Write the tree before and after optimisation to stderr.
+  bool dumpAst = false;
+  // Write the optimisation log, e.g. what was inlined, to stderr.
+  bool optLog = false;
+};
 const auto MonkeyFace = R"(
             __,__
    .--.  .-"     "-.  .--.
@@ -29,7 +49,148 @@ void printParserErrors(const std::vector<std::string> &errors) {
     std::cout << "\t" << err << std::endl;
   }
 }
-int main() {
+// Loads the compiled form of a script: the file itself if it is a .mkc,
+// otherwise a .mkc next to it that was compiled from the same text. Returns
+// null if there is none or it cannot be used.
+std::unique_ptr<monkey::parser::ast::Program>
+loadCompiled(const std::string &path, const monkey::lexer::Source &source) {
+  namespace mkc = monkey::parser::mkc;
+  auto compiled = std::filesystem::path(path).replace_extension(mkc::EXTENSION);
+  if (compiled == path) {
+    return mkc::load(path);
+  }
+  try {
+    if (mkc::recordedHash(compiled) == mkc::hashSource(source.text())) {
+      return mkc::load(compiled);
+    }
+  } catch (const std::exception &) {
+    // Missing or stale; parse the script instead.
+  }
+  return nullptr;
+}
+
+// wholeProgram is false for REPL lines, which later lines may follow up on.
+void optimize(monkey::parser::ast::Program &program, const Options &options,
+              bool wholeProgram = true) {
+  monkey::parser::opt::PassManager(options.level, wholeProgram)
+      .run(program, options.dumpAst ? &std::cerr : nullptr,
+           options.optLog ? &std::cerr : nullptr);
+}
+
+// Parses the script at path, or from standard input while it is being read
+// if path is STDIN_SCRIPT. A script file is lexed straight over a read-only
+// mapping of it unless a compiled copy can be used.
+std::unique_ptr<monkey::parser::ast::Program>
+loadScript(const std::string &path, std::vector<std::string> &errors) {
+  if (path == STDIN_SCRIPT) {
+    monkey::lexer::StreamLexer l(STDIN_FILENO);
+    monkey::parser::Parser p(&l);
+    auto program = p.parseProgram();
+    errors = p.getErrors();
+    return program;
+  }
+  auto source = monkey::lexer::Source::mapFile(path);
+  if (auto program = loadCompiled(path, *source)) {
+    return program;
+  }
+  monkey::lexer::Lexer l(source);
+  monkey::parser::Parser p(&l);
+  auto program = p.parseProgram();
+  errors = p.getErrors();
+  return program;
+}
+
+// Runs a whole script.
+int runScript(const std::string &path, const Options &options) {
+  std::unique_ptr<monkey::parser::ast::Program> program;
+  std::vector<std::string> errors;
+  try {
+    program = loadScript(path, errors);
+  } catch (const std::system_error &e) {
+    std::cerr << "cannot read script: " << e.what() << std::endl;
+    return 1;
+  } catch (const monkey::parser::mkc::FormatError &e) {
+    std::cerr << "cannot load " << path << ": " << e.what() << std::endl;
+    return 1;
+  }
+  if (errors.size() != 0) {
+    printParserErrors(errors);
+    return 1;
+  }
+  optimize(*program, options);
+  auto env = std::make_shared<monkey::evaluator::EnvironmentImpl>();
+  auto evaluated = monkey::evaluator::Evaluator().eval(program.get(), env);
+  if (evaluated != nullptr) {
+    std::cout << evaluated->to_string() << std::endl;
+  }
+  return 0;
+}
+
+// Runs a script while it is being parsed: each top-level statement is
+// evaluated as soon as the parser has finished it, and freed afterwards.
+// With more than one core the parser runs ahead on a thread of its own.
+// Statements before a parse error have already run when it is reported.
+// Statements are not optimised. With STDIN_SCRIPT, statements run as soon
+// as they have arrived on standard input.
+int streamScript(const std::string &path) {
+  bool parseAhead = std::thread::hardware_concurrency() > 1;
+  std::unique_ptr<monkey::parser::StatementStream> stream;
+  try {
+    if (path == STDIN_SCRIPT) {
+      stream = std::make_unique<monkey::parser::StatementStream>(STDIN_FILENO,
+                                                                 parseAhead);
+    } else {
+      stream = std::make_unique<monkey::parser::StatementStream>(
+          monkey::lexer::Source::mapFile(path), parseAhead);
+    }
+  } catch (const std::system_error &e) {
+    std::cerr << "cannot read script: " << e.what() << std::endl;
+    return 1;
+  }
+  auto env = std::make_shared<monkey::evaluator::EnvironmentImpl>();
+  auto evaluated = monkey::evaluator::Evaluator().evalStream(*stream, env);
+  if (!stream->errors().empty()) {
+    printParserErrors(stream->errors());
+    return 1;
+  }
+  if (evaluated != nullptr) {
+    std::cout << evaluated->to_string() << std::endl;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  bool stream = false;
+  std::string script;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--stream") {
+      stream = true;
+    } else if (arg == "--dump-ast") {
+      options.dumpAst = true;
+    } else if (arg == "--opt-log") {
+      options.optLog = true;
+    } else if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' &&
+               arg[2] <= '0' + monkey::parser::opt::PassManager::kMaxLevel) {
+      options.level = arg[2] - '0';
+    } else if ((arg.starts_with("-") && arg != STDIN_SCRIPT) ||
+               !script.empty()) {
+      std::cerr << "usage: " << argv[0]
+                << " [-O0|-O1|-O2] [--dump-ast] [--opt-log] [--stream]"
+                   " [script|-]"
+                << std::endl;
+      return 2;
+    } else {
+      script = arg;
+    }
+  }
+  if (stream && !script.empty()) {
+    return streamScript(script);
+  }
+  if (!script.empty()) {
+    return runScript(script, options);
+  }
   std::cout << "Hello, Monkey! version : " << VERSION << std::endl;
   std::cout << "Feel free to type in commands" << std::endl;
   auto env = std::make_shared<monkey::evaluator::EnvironmentImpl>();
@@ -49,6 +210,7 @@ int main() {
       continue;
     }
     std::cout << "Parsed: " <<program->to_string() << std::endl;
+    optimize(*program, options, false);
 
     auto evaluated = monkey::evaluator::Evaluator().eval(program.get(), env);
     if (evaluated != nullptr) {
@@ -1,4 +1,8 @@
+#include "../parser/arena.hpp"
+#include "../eval/evaluator.hpp"
 #include "../parser/ast.hpp"
+#include "../parser/flat_ast.hpp"
+#include "../parser/parser.hpp"
 #include <boost/test/unit_test.hpp>
 
 using namespace monkey::parser::ast;
@@ -15,4 +19,87 @@ BOOST_AUTO_TEST_CASE(TestAST){
     letStmt->value = std::move(ident2);
     program->statements.push_back(std::move(letStmt));
     BOOST_CHECK_EQUAL(program->to_string(), "let myVar = anotherVar;");
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestArenaOwnedProgram) {
+  Lexer l("let add = fn(a, b) { a + b }; add(1, [2, 3]);");
+  monkey::parser::Parser p(&l);
+  auto program = p.parseProgram();
+  BOOST_REQUIRE(program->arena != nullptr);
+  BOOST_REQUIRE_EQUAL(program->statements.size(), 2);
+  BOOST_CHECK(program->statements[0]->inArena);
+  BOOST_CHECK_GT(program->arena->reserved(), 0u);
+
+  // Nodes live as long as the arena, not the Program that pointed at them.
+  auto arena = program->arena;
+  auto *call = program->statements[1].get();
+  auto expected = call->to_string();
+  program.reset();
+  BOOST_CHECK_EQUAL(call->to_string(), expected);
+}
+
+BOOST_AUTO_TEST_CASE(TestFlatTreeRoundTrip) {
+  Lexer l(R"(
+      let fib = fn(n) {
+        if (n < 2) { return n; } else { fib(n - 1) + fib(n - 2) }
+      };
+      let xs = fn() { [1, -2 * 3, "four", !true, 0x10000000F] };
+      fib(10) + len("abc");
+  )");
+  monkey::parser::Parser p(&l);
+  auto program = p.parseProgram();
+  BOOST_REQUIRE(p.getErrors().empty());
+  BOOST_CHECK(program->statements[0]->Type() == StatementType::LET);
+
+  auto tree = monkey::parser::flat::flatten(*program);
+  BOOST_CHECK_EQUAL(tree.statements.size(), 3);
+  BOOST_CHECK_EQUAL(monkey::parser::flat::to_string(tree),
+                    program->to_string());
+  BOOST_CHECK_GT(tree.memoryUsage(), 0u);
+
+  auto rebuilt = monkey::parser::flat::unflatten(tree);
+  BOOST_CHECK_EQUAL(rebuilt->to_string(), program->to_string());
+
+  monkey::evaluator::Evaluator evaluator;
+  auto env = std::make_shared<monkey::evaluator::EnvironmentImpl>();
+  program.reset();
+  auto result = evaluator.eval(rebuilt.get(), env);
+  BOOST_REQUIRE_EQUAL(result->type(), monkey::evaluator::INTEGER_OBJ);
+  BOOST_CHECK_EQUAL(
+      dynamic_cast<const monkey::evaluator::Integer &>(*result).value_, 58);
+}
+
+BOOST_AUTO_TEST_CASE(TestFlattenNeedsSource) {
+  Program program;
+  BOOST_CHECK_THROW(monkey::parser::flat::flatten(program),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestNodeSpans) {
+  // A node is its vtable pointer, a view of its token and its children.
+  BOOST_CHECK_LE(sizeof(Identifier), 32u);
+  BOOST_CHECK_LE(sizeof(InfixExpression), 40u);
+
+  Lexer l("let a = 1;\nlet bb = a +\n  2;");
+  monkey::parser::Parser p(&l);
+  auto program = p.parseProgram();
+  BOOST_REQUIRE_EQUAL(program->statements.size(), 2);
+  auto let = dynamic_cast<LetStatement *>(program->statements[1].get());
+  BOOST_REQUIRE(let != nullptr);
+  auto infix = dynamic_cast<InfixExpression *>(let->value.get());
+  BOOST_REQUIRE(infix != nullptr);
+  BOOST_CHECK(infix->op == Op::PLUS);
+  BOOST_CHECK(infix->tokenType() == TokenType::PLUS);
+  BOOST_CHECK_EQUAL(let->name->value(), "bb");
+
+  auto at = program->locate(*let);
+  BOOST_CHECK_EQUAL(at.line, 2u);
+  BOOST_CHECK_EQUAL(at.column, 1u);
+  at = program->locate(*infix);
+  BOOST_CHECK_EQUAL(at.line, 2u);
+  BOOST_CHECK_EQUAL(at.column, 12u);
+  at = program->locate(*infix->right);
+  BOOST_CHECK_EQUAL(at.line, 3u);
+  BOOST_CHECK_EQUAL(at.column, 3u);
+  BOOST_CHECK_THROW(program->source->locate(1000), std::out_of_range);
+}
@@ -1,8 +1,11 @@
 #include "../eval/evaluator.hpp"
 #include "../lexer/lexer.hpp"
+#include "../parser/optimizer.hpp"
+#include "../parser/parse_cache.hpp"
 #include "../parser/parser.hpp"
 
 #include <boost/test/unit_test.hpp>
+#include <cstdio>
 #include <optional>
 #include <variant>
 
@@ -51,7 +54,9 @@ BOOST_AUTO_TEST_CASE(TestEvalIntegerExpressions) {
                              {"2 * (5 + 10)", 30},
                              {"3 * 3 * 3 + 10", 37},
                              {"3 * (3 * 3) + 10", 37},
-                             {"(5 + 10 * 2 + 15 / 3) * 2 + -10", 50}};
+                             {"(5 + 10 * 2 + 15 / 3) * 2 + -10", 50},
+                             {"3_000_000_000 * 2", 6000000000},
+                             {"0xFF + 0b1", 256}};
 
   for (auto &[input, expected] : tests) {
     auto evaluated = testEval(input);
@@ -189,7 +194,8 @@ BOOST_AUTO_TEST_CASE(TestEvalLetStatements) {
       {"let a = 5; a;", 5},
       {"let a = 5 * 5; a;", 25},
       {"let a = 5; let b = a; b;", 5},
-      {"let a = 5; let b = a; let c = a + b + 5; c;", 15}};
+      {"let a = 5; let b = a; let c = a + b + 5; c;", 15},
+      {"let größe = 5; let 倍 = 2; größe * 倍;", 10}};
 
   for (auto &[input, expected] : tests) {
     auto evaluated = testEval(input);
@@ -239,6 +245,28 @@ BOOST_AUTO_TEST_CASE(TestClosures) {
   testIntegerObject(*evaluated, 4);
 }
 
+BOOST_AUTO_TEST_CASE(TestFunctionLiteralEvaluatedTwice) {
+  auto input = R"(
+        let make = fn(k) { fn(x) { x * k } };
+        let double = make(2);
+        let triple = make(3);
+        double(5) + triple(5);
+    )";
+  auto evaluated = testEval(input);
+  testIntegerObject(*evaluated, 25);
+}
+
+BOOST_AUTO_TEST_CASE(TestEvalCachedProgram) {
+  monkey::parser::ParseCache cache;
+  auto input = "let add = fn(a, b) { a + b }; add(2, 3);";
+  for (int i = 0; i < 3; i++) {
+    auto parsed = cache.parse(input);
+    auto env = std::make_shared<EnvironmentImpl>();
+    testIntegerObject(*Evaluator().eval(parsed->program.get(), env), 5);
+  }
+  BOOST_CHECK_EQUAL(cache.stats().misses, 1u);
+}
+
 BOOST_AUTO_TEST_CASE(TestEvalStringLiteral) {
   auto input = R"("Hello World!")";
   auto evaluated = testEval(input);
@@ -293,3 +321,159 @@ BOOST_AUTO_TEST_CASE(TestBuiltinFunctions){
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(TestEvalStreaming) {
+  std::string script = "let add = fn(a, b) { a + b };\n";
+  for (int i = 0; i < 500; i++) {
+    script += "let total = add(" + std::to_string(i) + ", 1) * 2;\n";
+  }
+  script += "if (total > 10) { return total; } 7;";
+  auto expected = testEval(script);
+  for (bool parseAhead : {false, true}) {
+    monkey::parser::StatementStream stream(monkey::lexer::makeSource(script),
+                                           parseAhead, 4);
+    auto env = std::make_shared<EnvironmentImpl>();
+    auto evaluated = Evaluator().evalStream(stream, env);
+    BOOST_CHECK(stream.errors().empty());
+    testIntegerObject(*evaluated, 1000);
+    testIntegerObject(*expected, 1000);
+  }
+
+  // The same script read from a file descriptor as it arrives.
+  auto file = std::tmpfile();
+  BOOST_REQUIRE(file != nullptr);
+  std::fwrite(script.data(), 1, script.size(), file);
+  std::fflush(file);
+  for (bool parseAhead : {false, true}) {
+    std::rewind(file);
+    monkey::parser::StatementStream stream(fileno(file), parseAhead, 4);
+    auto env = std::make_shared<EnvironmentImpl>();
+    auto evaluated = Evaluator().evalStream(stream, env);
+    BOOST_CHECK(stream.errors().empty());
+    testIntegerObject(*evaluated, 1000);
+  }
+  std::fclose(file);
+
+  // Statements before a parse error have run; the errors are all reported.
+  auto broken = "let a = 5; let b = a * 2; let = 1; let c = ;";
+  auto l = monkey::lexer::Lexer(broken);
+  auto p = monkey::parser::Parser(&l);
+  p.parseProgram();
+  for (bool parseAhead : {false, true}) {
+    monkey::parser::StatementStream stream(monkey::lexer::makeSource(broken),
+                                           parseAhead);
+    auto env = std::make_shared<EnvironmentImpl>();
+    Evaluator().evalStream(stream, env);
+    BOOST_CHECK(stream.errors() == p.getErrors());
+    BOOST_CHECK_EQUAL(stream.errors().size(), 3);
+    testIntegerObject(*env->get(monkey::lexer::intern("b")).value, 10);
+  }
+
+  // A statement's tree is freed once it has run, unless a function made by
+  // it is still reachable.
+  monkey::parser::StatementStream stream(
+      monkey::lexer::makeSource("let f = fn(x) { x }; 1 + 2; f(3);"));
+  auto env = std::make_shared<EnvironmentImpl>();
+  Evaluator evaluator;
+  std::vector<std::weak_ptr<monkey::parser::ast::Arena>> arenas;
+  monkey::parser::ParsedStatement parsed;
+  while (stream.next(parsed)) {
+    arenas.push_back(parsed.arena);
+    evaluator.eval(parsed, env);
+  }
+  parsed = {};
+  BOOST_REQUIRE_EQUAL(arenas.size(), 3);
+  BOOST_CHECK(!arenas[0].expired());
+  BOOST_CHECK(arenas[1].expired());
+}
+
+BOOST_AUTO_TEST_CASE(TestEvalOptimizedProgram) {
+  std::vector<std::string> inputs = {
+      "2 * (5 + 10)",
+      "let f = fn(x) { if (1 < 2) { return x * (3 + 4); 99 } 0 }; f(6);",
+      "if (false) { 10 }; if (\"s\") { let a = 2; a * a }",
+      "if (false) { 10 }",
+      "let x = 1; if (true) { let x = 2; } x",
+      R"("Hello" + " " + "World!")",
+      R"(len("ab" + "cd") + -(-1))",
+      "!(1 == 1) != !!false",
+      "-true",
+      R"("a" - "b")",
+      "fn() { return 1; 1 / 0 }()",
+      "9223372036854775807 + 0",
+      "let x = 2; let add = fn(a, b) { a + b }; let g = fn(x) { add(x, x) };"
+      "g(7) * 10 + add(x, 1)",
+      "let k = 1; let f = fn(a) { a + k }; let h = fn(k) { f(k) }; h(5)",
+      "let f = fn(a) { if (a > 1) { a } else { 0 } }; f(3) * 10 + f(1)",
+      "let f = fn(a) { a + true }; f(1)",
+      "let f = fn(a, b) { b }; let g = fn(y) { f(y, 2) }; g(1)",
+  };
+  for (const auto &input : inputs) {
+    auto expected = testEval(input);
+    auto l = monkey::lexer::Lexer(input);
+    auto p = monkey::parser::Parser(&l);
+    auto program = p.parseProgram();
+    monkey::parser::opt::PassManager(2).run(*program);
+    auto env = std::make_shared<EnvironmentImpl>();
+    auto evaluated = Evaluator().eval(program.get(), env);
+    BOOST_CHECK_EQUAL(evaluated->type(), expected->type());
+    BOOST_CHECK_EQUAL(evaluated->to_string(), expected->to_string());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestEvalResolvedScopes) {
+  struct Test {
+    std::string input;
+    int64_t expected;
+  };
+  std::vector<Test> tests = {
+      {"let make = fn(x) { fn(y) { x + y } }; make(2)(3);", 5},
+      {"fn(a) { fn(b) { fn(c) { a * b - c } } }(2)(3)(4)", 2},
+      {"let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };"
+       "fib(15);",
+       610},
+      // A slot whose let has not run yet leaves the name to outer scopes.
+      {"let x = 1; let f = fn() { let y = x; let x = 2; y * 10 + x }; f();",
+       12},
+      {"let x = 10; let f = fn(c) { if (c) { let x = 1; } x };"
+       "f(false) * 100 + f(true);",
+       1001},
+      {"let f = fn() { let g = fn() { x }; let x = 5; g() }; f();", 5},
+      {"let f = fn(a, a) { a }; f(1, 2);", 2},
+      {"let f = fn(a) { let a = a * 2; a }; f(4);", 8},
+      {"let f = fn(len) { len }; f(3) + len(\"four\");", 7},
+  };
+  for (const auto &[input, expected] : tests) {
+    auto l = monkey::lexer::Lexer(input);
+    auto p = monkey::parser::Parser(&l);
+    auto program = p.parseProgram();
+    monkey::parser::opt::PassManager(1).run(*program);
+    auto env = std::make_shared<EnvironmentImpl>();
+    testIntegerObject(*Evaluator().eval(program.get(), env), expected);
+    testIntegerObject(*testEval(input), expected);
+  }
+
+  // Globals stay dynamic: a later program can bind what a function reads.
+  auto env = std::make_shared<EnvironmentImpl>();
+  Evaluator evaluator;
+  std::vector<std::unique_ptr<monkey::parser::ast::Program>> programs;
+  ObjectPtr result;
+  for (auto line : {"let f = fn(x) { x + y };", "let y = 2;", "f(1)"}) {
+    auto l = monkey::lexer::Lexer(line);
+    programs.push_back(monkey::parser::Parser(&l).parseProgram());
+    monkey::parser::opt::PassManager(1).run(*programs.back());
+    result = evaluator.eval(programs.back().get(), env);
+  }
+  testIntegerObject(*result, 3);
+  auto unbound = testEval("fn() { z }()");
+  BOOST_CHECK_EQUAL(unbound->to_string(), "identifier not found: z");
+}
+
+BOOST_AUTO_TEST_CASE(TestEvalLongOperatorChain) {
+  // Chains are as tall as they are long, but well under the height limit.
+  std::string sum = "1";
+  for (int i = 1; i < 5000; i++) {
+    sum += " + 1";
+  }
+  testIntegerObject(*testEval(sum), 5000);
+}
@@ -1,7 +1,19 @@
 #define BOOST_TEST_MODULE MonkeyInterpreterTest
+#include "../lexer/incremental_lexer.hpp"
 #include "../lexer/lexer.hpp"
+#include "../lexer/symbol.hpp"
+#include "../lexer/utf8.hpp"
+#include "../lexer/parallel_lexer.hpp"
+#include "../lexer/pipelined_lexer.hpp"
+#include "../lexer/spsc_ring.hpp"
+#include "../lexer/scan.hpp"
+#include "../lexer/stream_lexer.hpp"
 #include "../lexer/token.hpp"
+#include <array>
 #include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
 
 using namespace monkey::lexer;
 using TT = TokenType;
@@ -154,3 +166,404 @@ BOOST_AUTO_TEST_CASE(TestArray) {
 
   checkTokens(input, testResults);
 }
+
+std::vector<Token> lexAll(Lexer &lexer) {
+  std::vector<Token> tokens;
+  do {
+    tokens.push_back(lexer.nextToken());
+  } while (tokens.back().type != TT::EOFILE);
+  return tokens;
+}
+
+BOOST_AUTO_TEST_CASE(TestMappedSource) {
+  std::string input = R"(let add = fn(x, y) { x + y; }; add("a b", 10);)";
+  char path[] = "/tmp/monkey_lexer_testXXXXXX";
+  int fd = mkstemp(path);
+  BOOST_REQUIRE(fd >= 0);
+  BOOST_REQUIRE_EQUAL(write(fd, input.data(), input.size()), input.size());
+  close(fd);
+
+  auto source = Source::mapFile(path);
+  unlink(path);
+  BOOST_CHECK(source->isMapped());
+  BOOST_CHECK_EQUAL(source->text(), input);
+
+  Lexer mapped(source);
+  Lexer inMemory(input);
+  auto expected = lexAll(inMemory);
+  auto actual = lexAll(mapped);
+  BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(),
+                                expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(TestStreamLexerChunkBoundaries) {
+  std::string input = R"(
+        let five = 5;
+        let message = "split across a chunk";
+        let add = fn(x, y) { x + y; };
+        if (add(five, 10) != 15) { return false; } else { return true; }
+    )";
+  Lexer whole(input);
+  auto expected = lexAll(whole);
+
+  for (size_t chunkSize : {1, 3, 7, 64, 4096}) {
+    auto file = std::tmpfile();
+    BOOST_REQUIRE(file != nullptr);
+    std::fwrite(input.data(), 1, input.size(), file);
+    std::fflush(file);
+    std::rewind(file);
+
+    StreamLexer lexer(fileno(file), chunkSize);
+    Token previous = lexer.nextToken();
+    BOOST_CHECK_EQUAL(previous, expected[0]);
+    for (size_t i = 1; i < expected.size(); i++) {
+      auto tok = lexer.nextToken();
+      BOOST_CHECK_EQUAL(tok, expected[i]);
+      // The previous token must survive one more call, as the parser keeps
+      // both curToken and peekToken.
+      BOOST_CHECK_EQUAL(previous, expected[i - 1]);
+      previous = tok;
+    }
+    BOOST_CHECK_EQUAL(lexer.nextToken().type, TT::EOFILE);
+    std::fclose(file);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestScanImplementationsAgree) {
+  std::string input;
+  for (int i = 0; i < 4096; i++) {
+    input += static_cast<char>((i * 7919 + i / 13) % 256);
+    if (i % 97 == 0) {
+      input += std::string(i % 61, "  \t\nab9\""[i % 8]);
+    }
+  }
+  auto best = scan::bestSupportedIsa();
+  for (size_t pos = 0; pos < input.size(); pos++) {
+    scan::setIsa(scan::Isa::SCALAR);
+    auto expected = std::array{scan::skipWhitespace(input, pos),
+                               scan::skipAlpha(input, pos),
+                               scan::skipDigits(input, pos),
+                               scan::skipStringBody(input, pos),
+                               scan::skipAscii(input, pos)};
+    for (auto isa : {scan::Isa::SSE2, scan::Isa::AVX2}) {
+      if (scan::setIsa(isa) != isa) {
+        continue;
+      }
+      auto actual = std::array{scan::skipWhitespace(input, pos),
+                               scan::skipAlpha(input, pos),
+                               scan::skipDigits(input, pos),
+                               scan::skipStringBody(input, pos),
+                               scan::skipAscii(input, pos)};
+      BOOST_REQUIRE(actual == expected);
+    }
+  }
+  scan::setIsa(best);
+}
+
+BOOST_AUTO_TEST_CASE(TestLookupIdent) {
+  std::vector<std::pair<std::string, TT>> tests = {
+      {"fn", TT::FUNCTION}, {"let", TT::LET},     {"true", TT::TRUE},
+      {"false", TT::FALSE}, {"if", TT::IF},       {"else", TT::ELSE},
+      {"return", TT::RETURN}, {"f", TT::IDENT},   {"fun", TT::IDENT},
+      {"lets", TT::IDENT},  {"If", TT::IDENT},    {"esle", TT::IDENT},
+      {"returns", TT::IDENT}, {"fo", TT::IDENT},  {"x", TT::IDENT}};
+
+  for (auto &[ident, expected] : tests) {
+    BOOST_CHECK_EQUAL(LookupIdent(ident), expected);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestTokenStreamLimits) {
+  // Offsets are 32 bits, so larger sources are refused rather than wrapped.
+  // The file is sparse and only mapped, never read.
+  char path[] = "/tmp/monkey_lexer_testXXXXXX";
+  int fd = mkstemp(path);
+  BOOST_REQUIRE(fd >= 0);
+  BOOST_REQUIRE_EQUAL(ftruncate(fd, TokenStream::kMaxSourceSize + 1), 0);
+  close(fd);
+  auto huge = Source::mapFile(path);
+  unlink(path);
+  BOOST_CHECK_THROW(TokenStream{huge}, std::length_error);
+  BOOST_CHECK_THROW(Lexer(huge).tokenizeAll(), std::length_error);
+
+  TokenStream empty;
+  BOOST_CHECK_EQUAL(empty.token(0).type, TT::EOFILE);
+  BOOST_CHECK_THROW(relex(empty, {0, 0, "x"}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestTokenizeAll) {
+  auto input = R"(
+        let add = fn(x, y) { x + y; };
+        if (add(5, 10) != 15) { return "wrong"; } ~ [1, 2];
+    )";
+  Lexer streamed(input);
+  auto tokens = streamed.tokenizeAll();
+  Lexer sequential(input);
+  auto expected = lexAll(sequential);
+
+  BOOST_REQUIRE_EQUAL(tokens.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    BOOST_CHECK_EQUAL(tokens.token(i), expected[i]);
+    BOOST_CHECK_EQUAL(tokens.literal(i).data(), expected[i].literal.data());
+  }
+  BOOST_CHECK_EQUAL(tokens.token(tokens.size() + 10).type, TT::EOFILE);
+
+  // Thirteen bytes a token, plus the side table of the few integer values,
+  // which grows by doubling.
+  std::string script;
+  for (int i = 0; i < 1000; i++) {
+    script += i % 100 == 0 ? "let total = total + 42;\n"
+                           : "let total = total + step;\n";
+  }
+  auto lexed = Lexer(script).tokenizeAll();
+  TokenStream exact(lexed.source());
+  exact.reserve(lexed.size());
+  exact.append(lexed, lexed.size());
+  size_t integers = 0;
+  for (size_t i = 0; i < exact.size(); i++) {
+    integers += exact.type(i) == TT::INT;
+    BOOST_CHECK_EQUAL(exact.payload(i), lexed.payload(i));
+  }
+  BOOST_REQUIRE_EQUAL(integers, 10u);
+  BOOST_CHECK_LE(exact.memoryUsage(),
+                 13 * exact.size() + 2 * integers * sizeof(int64_t));
+  BOOST_CHECK_EQUAL(exact.payload(3), intern("total"));
+}
+
+BOOST_AUTO_TEST_CASE(TestNumberLiterals) {
+  std::vector<std::tuple<std::string, TT, int64_t>> tests = {
+      {"0", TT::INT, 0},
+      {"1234567890", TT::INT, 1234567890},
+      {"9223372036854775807", TT::INT, INT64_MAX},
+      {"1_000_000", TT::INT, 1000000},
+      {"0x7fFF_ffff_FFFF_ffff", TT::INT, INT64_MAX},
+      {"0XfF", TT::INT, 255},
+      {"0b1010_1010", TT::INT, 170},
+      {"0B1", TT::INT, 1},
+      {"9223372036854775808", TT::ILLEGAL,
+       static_cast<int64_t>(LexError::NUMBER_OUT_OF_RANGE)},
+      {"0x8000000000000000", TT::ILLEGAL,
+       static_cast<int64_t>(LexError::NUMBER_OUT_OF_RANGE)},
+      {"1__0", TT::ILLEGAL, static_cast<int64_t>(LexError::MALFORMED_NUMBER)},
+      {"10_", TT::ILLEGAL, static_cast<int64_t>(LexError::MALFORMED_NUMBER)},
+      {"0x", TT::ILLEGAL, static_cast<int64_t>(LexError::MALFORMED_NUMBER)},
+      {"0x_1", TT::ILLEGAL, static_cast<int64_t>(LexError::MALFORMED_NUMBER)},
+      {"0b102", TT::ILLEGAL, static_cast<int64_t>(LexError::MALFORMED_NUMBER)},
+  };
+
+  for (auto &[input, type, payload] : tests) {
+    Lexer lexer(input + ";");
+    auto tok = lexer.nextToken();
+    BOOST_CHECK_EQUAL(tok, Token(type, input));
+    BOOST_CHECK_EQUAL(tok.payload, payload);
+    BOOST_CHECK_EQUAL(lexer.nextToken().type, TT::SEMICOLON);
+
+    Lexer batch(input);
+    auto tokens = batch.tokenizeAll();
+    BOOST_CHECK_EQUAL(tokens.token(0).payload, payload);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelTokenizeMatchesSequential) {
+  std::string input;
+  for (int i = 0; i < 200; i++) {
+    auto n = std::to_string(i);
+    input += "let v" + n + " = \"a string with spaces " + n + "\";\n";
+    input += "if (v != " + n + ") { return 0x" + n + "; }\t";
+  }
+  std::vector<std::string> inputs = {input, input + "\"unterminated  tail",
+                                     "\"" + input, std::string(5000, ' ')};
+
+  for (auto &text : inputs) {
+    auto source = makeSource(text);
+    auto expected = Lexer(source).tokenizeAll();
+    for (unsigned threads : {1, 2, 3, 8, 16}) {
+      auto tokens = tokenizeParallel(source, threads, 64);
+      BOOST_REQUIRE_EQUAL(tokens.size(), expected.size());
+      for (size_t i = 0; i < expected.size(); i++) {
+        BOOST_REQUIRE_EQUAL(tokens.type(i), expected.type(i));
+        BOOST_REQUIRE_EQUAL(tokens.start(i), expected.start(i));
+        BOOST_REQUIRE_EQUAL(tokens.length(i), expected.length(i));
+        BOOST_REQUIRE_EQUAL(tokens.payload(i), expected.payload(i));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestRelexMatchesFullLex) {
+  std::string base = "let add = fn(x, y) { x + y; };\n"
+                     "let s = \"hello world\"; if (a >= 10) { 0x1F_FF }\n"
+                     "let result = add(5, 10) != 15;\n";
+  std::vector<TextEdit> edits = {
+      {0, 0, "let z = 1; "},   // insert at the start
+      {4, 3, "sum"},           // rename inside an identifier
+      {5, 0, "x"},             // extend an identifier
+      {31, 0, "\""},          // open a string that swallows the rest
+      {41, 1, "_"},            // edit inside a string literal
+      {52, 1, ""},             // turn >= into >
+      {50, 0, "!"},            // "a" becomes "!a"
+      {base.size(), 0, ";"},   // append at the end
+      {0, base.size(), "42"},  // replace everything
+      {60, 2, "  \t"},        // whitespace only
+  };
+
+  auto check = [](const std::string &base, const TextEdit &edit) {
+    auto old = Lexer(base).tokenizeAll();
+    auto relexed = relex(old, edit);
+    auto text = base;
+    text.replace(edit.offset, edit.removed, edit.inserted);
+    BOOST_REQUIRE_EQUAL(relexed.tokens.source()->text(), text);
+    auto expected = Lexer(text).tokenizeAll();
+    BOOST_REQUIRE_EQUAL(relexed.tokens.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      BOOST_REQUIRE_EQUAL(relexed.tokens.type(i), expected.type(i));
+      BOOST_REQUIRE_EQUAL(relexed.tokens.start(i), expected.start(i));
+      BOOST_REQUIRE_EQUAL(relexed.tokens.length(i), expected.length(i));
+      BOOST_REQUIRE_EQUAL(relexed.tokens.payload(i), expected.payload(i));
+    }
+    BOOST_CHECK_EQUAL(relexed.tokens.size() - relexed.newEnd,
+                      old.size() - relexed.oldEnd);
+  };
+  for (auto &edit : edits) {
+    check(base, edit);
+  }
+
+  // An empty string literal covers just its two quotes, so re-lexing does
+  // not restart inside the identifier after it.
+  check("\"\"ab   x;", {7, 1, "y"});
+  std::string empties = "\"\"ab \"\"\"\"1 x\"\";";
+  for (size_t offset = 0; offset < empties.size(); offset++) {
+    check(empties, {offset, 1, "y"});
+    check(empties, {offset, 0, " "});
+  }
+
+  // Changing a continuation byte can turn a stray character into part of
+  // the identifier before it.
+  auto euro = relex(Lexer("let ab\u20ac = 1;").tokenizeAll(),
+                    {7, 2, "\xB4\x80"});
+  BOOST_CHECK_EQUAL(euro.tokens.type(1), TT::IDENT);
+  BOOST_CHECK_EQUAL(euro.tokens.literal(1), "ab\u2d00");
+  BOOST_CHECK_EQUAL(euro.tokens.type(2), TT::ASSIGN);
+
+  // A one-character rename re-lexes a handful of tokens, not the file.
+  std::string big;
+  for (int i = 0; i < 1000; i++) {
+    big += "let v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+  }
+  auto old = Lexer(big).tokenizeAll();
+  auto relexed = relex(old, {big.size() / 2, 0, "q"});
+  BOOST_CHECK_LE(relexed.newEnd - relexed.firstChanged, 3u);
+  BOOST_CHECK_LE(relexed.oldEnd - relexed.firstChanged, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(TestIdentifierSymbols) {
+  Lexer l("let foo = bar + foo; fn");
+  auto tokens = lexAll(l);
+  BOOST_REQUIRE_EQUAL(tokens.size(), 9u);
+  auto foo = static_cast<Symbol>(tokens[1].payload);
+  auto bar = static_cast<Symbol>(tokens[3].payload);
+  BOOST_CHECK_NE(foo, NO_SYMBOL);
+  BOOST_CHECK_NE(foo, bar);
+  BOOST_CHECK_EQUAL(tokens[5].payload, foo);
+  BOOST_CHECK_EQUAL(tokens[0].payload, 0);
+  BOOST_CHECK_EQUAL(tokens[7].payload, 0);
+  BOOST_CHECK_EQUAL(intern("foo"), foo);
+  BOOST_CHECK_EQUAL(symbolName(foo), "foo");
+  BOOST_CHECK_EQUAL(symbolName(bar), "bar");
+  BOOST_CHECK_EQUAL(symbolName(NO_SYMBOL), "");
+}
+
+BOOST_AUTO_TEST_CASE(TestUnicodeIdentifiersAndStrings) {
+  auto utf8Error = static_cast<int64_t>(LexError::INVALID_UTF8);
+  auto unexpected = static_cast<int64_t>(LexError::UNEXPECTED_CHARACTER);
+  struct Test {
+    std::string input;
+    std::vector<std::pair<TT, std::string>> expected;
+    std::vector<int64_t> errors;
+  };
+  std::vector<Test> tests = {
+      {"let größe = 1;",
+       {{TT::LET, "let"}, {TT::IDENT, "größe"}, {TT::ASSIGN, "="},
+        {TT::INT, "1"}, {TT::SEMICOLON, ";"}},
+       {}},
+      {"変数 + ñ",
+       {{TT::IDENT, "変数"}, {TT::PLUS, "+"}, {TT::IDENT, "ñ"}},
+       {}},
+      {"x\u20ac", {{TT::IDENT, "x"}, {TT::ILLEGAL, "\u20ac"}}, {0, unexpected}},
+      {"a\xFF", {{TT::IDENT, "a"}, {TT::ILLEGAL, "\xFF"}}, {0, utf8Error}},
+      {"\"héllo wörld\"", {{TT::STRING, "héllo wörld"}}, {}},
+      {"\"bad \xC3\x28\" 1",
+       {{TT::ILLEGAL, "\"bad \xC3\x28\""}, {TT::INT, "1"}},
+       {utf8Error, 1}},
+  };
+
+  for (auto &[input, expected, errors] : tests) {
+    Lexer l(input);
+    auto tokens = lexAll(l);
+    BOOST_REQUIRE_EQUAL(tokens.size(), expected.size() + 1);
+    for (size_t i = 0; i < expected.size(); i++) {
+      BOOST_CHECK_EQUAL(tokens[i].type, expected[i].first);
+      BOOST_CHECK_EQUAL(tokens[i].literal, expected[i].second);
+      if (expected[i].first == TT::ILLEGAL) {
+        BOOST_CHECK_EQUAL(tokens[i].payload, errors[i]);
+      }
+    }
+  }
+
+  BOOST_CHECK(utf8::isValid("plain ascii, then ü, 変, 😀"));
+  for (auto bad : {"\xC0\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80",
+                   "\xE2\x82", "\x80", "\xF8\x88\x80\x80\x80"}) {
+    BOOST_CHECK(!utf8::isValid(std::string(64, 'a') + bad));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestSpscRingTransfersInOrder) {
+  SpscRing<int> ring(8);
+  constexpr int count = 100000;
+  std::thread producer([&] {
+    int batch[5];
+    for (int i = 0; i < count; i += 5) {
+      for (int j = 0; j < 5; j++) {
+        batch[j] = i + j;
+      }
+      ring.push(batch, 5);
+    }
+    ring.close();
+  });
+  int expected = 0;
+  int items[3];
+  while (size_t n = ring.pop(items, 3)) {
+    for (size_t i = 0; i < n; i++) {
+      BOOST_REQUIRE_EQUAL(items[i], expected++);
+    }
+  }
+  producer.join();
+  BOOST_CHECK_EQUAL(expected, count);
+}
+
+BOOST_AUTO_TEST_CASE(TestPipelinedLexerMatchesLexer) {
+  std::string input;
+  for (int i = 0; i < 500; i++) {
+    input += "let x" + std::to_string(i) + " = \"s\" + 0x" +
+             std::to_string(i) + "; ";
+  }
+  auto source = makeSource(input);
+  Lexer expected(source);
+  PipelinedLexer pipelined(source, 16, 4);
+  while (true) {
+    auto want = expected.nextToken();
+    auto got = pipelined.nextToken();
+    BOOST_REQUIRE_EQUAL(got.type, want.type);
+    BOOST_REQUIRE_EQUAL(got.literal.data(), want.literal.data());
+    BOOST_REQUIRE_EQUAL(got.literal.size(), want.literal.size());
+    BOOST_REQUIRE_EQUAL(got.payload, want.payload);
+    if (want.type == TT::EOFILE) {
+      break;
+    }
+  }
+  BOOST_CHECK_EQUAL(pipelined.nextToken().type, TT::EOFILE);
+
+  // Abandoning a pipeline while its producer is blocked must not hang.
+  PipelinedLexer abandoned(source, 4, 2);
+  BOOST_CHECK_EQUAL(abandoned.nextToken().type, TT::LET);
+}
@@ -1,5 +1,18 @@
+#include "../parser/flat_ast.hpp"
+#include "../parser/incremental_parser.hpp"
+#include "../parser/mkc.hpp"
+#include "../parser/optimizer.hpp"
+#include "../parser/parse_cache.hpp"
 #include "../parser/parser.hpp"
+#include "../parser/resolver.hpp"
 #include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 #include <variant>
 
 using namespace monkey::parser;
@@ -27,7 +40,7 @@ template <typename T> T *getAs(AstChildNode auto *s) {
 void testLetStatement(Statement *s, std::string name) {
   BOOST_REQUIRE_EQUAL(s->TokenLiteral(), "let");
   auto letStmt = getAs<LetStatement>(s);
-  BOOST_REQUIRE_EQUAL(letStmt->name->value, name);
+  BOOST_REQUIRE_EQUAL(letStmt->name->value(), name);
   BOOST_REQUIRE_EQUAL(letStmt->name->TokenLiteral(), name);
 }
 
@@ -39,7 +52,7 @@ void testIntegerLiteral(ast::Expression *expr, int64_t value) {
 
 void testIdentifier(ast::Expression *expr, std::string value) {
   auto ident = getAs<ast::Identifier>(expr);
-  BOOST_REQUIRE_EQUAL(ident->value, value);
+  BOOST_REQUIRE_EQUAL(ident->value(), value);
   BOOST_REQUIRE_EQUAL(ident->TokenLiteral(), value);
 }
 
@@ -71,7 +84,7 @@ void testLiteralExpression(ast::Expression *expr, auto expected) {
 
 void testInfixExpression(InfixExpression *expr, auto left, std::string op,
                          auto right) {
-  BOOST_REQUIRE_EQUAL(expr->op, op);
+  BOOST_REQUIRE_EQUAL(to_string(expr->op), op);
   BOOST_REQUIRE_EQUAL(expr->TokenLiteral(), op);
   testLiteralExpression(expr->left.get(), left);
   testLiteralExpression(expr->right.get(), right);
@@ -163,6 +176,66 @@ BOOST_AUTO_TEST_CASE(TestIntegerLiteralExpression) {
   testIntegerLiteral(exprStmt->expression.get(), 5);
 }
 
+BOOST_AUTO_TEST_CASE(TestIntegerLiteralBases) {
+  std::vector<std::pair<std::string, int64_t>> tests = {
+      {"0x10;", 16},
+      {"0b101;", 5},
+      {"1_000_000;", 1000000},
+      {"9223372036854775807;", INT64_MAX},
+  };
+  for (auto &[input, value] : tests) {
+    auto program = testProgram(input);
+    auto exprStmt = getAs<ExpressionStatement>(program->statements[0].get());
+    auto literal = getAs<ast::IntegerLiteral>(exprStmt->expression.get());
+    BOOST_REQUIRE_EQUAL(literal->value, value);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestIntegerLiteralErrors) {
+  std::vector<std::pair<std::string, std::string>> tests = {
+      {"let x = 9223372036854775808;",
+       "integer literal 9223372036854775808 does not fit in 64 bits"},
+      {"0b12", "could not parse 0b12 as integer"},
+      {"1__2", "could not parse 1__2 as integer"},
+  };
+  for (auto &[input, message] : tests) {
+    monkey::lexer::Lexer l(input);
+    Parser p(&l);
+    p.parseProgram();
+    BOOST_REQUIRE_EQUAL(p.getErrors().size(), 1);
+    BOOST_CHECK_EQUAL(p.getErrors()[0], message);
+  }
+
+  // The bad literal ends its expression: the `+` after it is not parsed
+  // as an infix operator with a missing left operand.
+  monkey::lexer::Lexer l("0b12 + 3;");
+  Parser p(&l);
+  auto program = p.parseProgram();
+  BOOST_REQUIRE_EQUAL(p.getErrors().size(), 2);
+  BOOST_CHECK_EQUAL(p.getErrors()[0], "could not parse 0b12 as integer");
+  BOOST_CHECK_EQUAL(p.getErrors()[1], "no prefix parse function for PLUS found");
+  BOOST_REQUIRE(!program->statements.empty());
+  auto statement =
+      dynamic_cast<ExpressionStatement *>(program->statements[0].get());
+  BOOST_REQUIRE(statement != nullptr);
+  BOOST_CHECK(statement->expression == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(TestInvalidUtf8Errors) {
+  std::vector<std::pair<std::string, std::string>> tests = {
+      {"let s = \"caf\xE9\";",
+       "string literal \"caf\xE9\" is not valid UTF-8"},
+      {"1 + \xFF;", "invalid UTF-8 byte sequence"},
+  };
+  for (auto &[input, message] : tests) {
+    monkey::lexer::Lexer l(input);
+    Parser p(&l);
+    p.parseProgram();
+    BOOST_REQUIRE(!p.getErrors().empty());
+    BOOST_CHECK_EQUAL(p.getErrors()[0], message);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestParsingPrefixExpressions) {
   std::vector<std::tuple<std::string, std::string, ParsedTypes>> tests = {
       {"!5;", "!", 5},
@@ -175,7 +248,7 @@ BOOST_AUTO_TEST_CASE(TestParsingPrefixExpressions) {
     auto stmt = program->statements[0].get();
     auto exprStmt = getAs<ExpressionStatement>(stmt);
     auto prefixExpr = getAs<PrefixExpression>(exprStmt->expression.get());
-    BOOST_REQUIRE_EQUAL(prefixExpr->op, op);
+    BOOST_REQUIRE_EQUAL(to_string(prefixExpr->op), op);
     BOOST_REQUIRE_EQUAL(prefixExpr->TokenLiteral(), op);
     if (std::holds_alternative<int64_t>(value))
       testIntegerLiteral(prefixExpr->right.get(), std::get<int64_t>(value));
@@ -400,7 +473,7 @@ BOOST_AUTO_TEST_CASE(TestStringLiteral) {
   auto stmt = program->statements[0].get();
   auto exprStmt = getAs<ExpressionStatement>(stmt);
   auto literal = getAs<StringLiteral>(exprStmt->expression.get());
-  BOOST_REQUIRE_EQUAL(literal->value, "hello world");
+  BOOST_REQUIRE_EQUAL(literal->value(), "hello world");
 }
 
 BOOST_AUTO_TEST_CASE(TestArrayLiterals) {
@@ -416,3 +489,546 @@ BOOST_AUTO_TEST_CASE(TestArrayLiterals) {
   auto arg2 = getAs<InfixExpression>(array->elements[2].get());
   testInfixExpression(arg2, int64_t(3), "+", int64_t(3));
 }
+
+BOOST_AUTO_TEST_CASE(TestParseTokenStream) {
+  std::vector<std::string> tests = {
+      "let x = 5; let y = fn(a, b) { a * (b + 2) }; y(x, [1, 2]);",
+      "if (x < y) { return !x; } else { \"z\" }",
+      "let failure; let = 456;",
+  };
+
+  for (auto &input : tests) {
+    monkey::lexer::Lexer sequential(input);
+    Parser expectedParser(&sequential);
+    auto expected = expectedParser.parseProgram();
+
+    monkey::lexer::Lexer batch(input);
+    auto tokens = batch.tokenizeAll();
+    // One stream, parsed twice.
+    for (int i = 0; i < 2; i++) {
+      Parser p(&tokens);
+      auto program = p.parseProgram();
+      BOOST_CHECK_EQUAL(program->to_string(), expected->to_string());
+      auto errors = p.getErrors();
+      auto expectedErrors = expectedParser.getErrors();
+      BOOST_CHECK_EQUAL_COLLECTIONS(errors.begin(), errors.end(),
+                                    expectedErrors.begin(),
+                                    expectedErrors.end());
+    }
+
+    // The same program again, lexed on a producer thread through a ring
+    // small enough to keep it blocking.
+    monkey::lexer::PipelinedLexer pipeline(monkey::lexer::makeSource(input),
+                                           4, 2);
+    Parser p(&pipeline);
+    auto program = p.parseProgram();
+    BOOST_CHECK_EQUAL(program->to_string(), expected->to_string());
+    BOOST_CHECK_EQUAL(p.getErrors().size(), expectedParser.getErrors().size());
+
+    // And read from a file in chunks small enough that most tokens are in
+    // windows of their own; the tree outlives the lexer.
+    auto file = std::tmpfile();
+    BOOST_REQUIRE(file != nullptr);
+    std::fwrite(input.data(), 1, input.size(), file);
+    std::fflush(file);
+    std::rewind(file);
+    std::unique_ptr<Program> streamed;
+    {
+      monkey::lexer::StreamLexer stream(fileno(file), 3);
+      Parser p(&stream);
+      streamed = p.parseProgram();
+      BOOST_CHECK(p.getErrors() == expectedParser.getErrors());
+    }
+    std::fclose(file);
+    BOOST_CHECK_EQUAL(streamed->to_string(), expected->to_string());
+    BOOST_CHECK(streamed->source == nullptr);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestParseCache) {
+  ParseCache cache(1 << 20);
+  auto first = cache.parse("let x = 1 + 2; x * 3;");
+  auto again = cache.parse("let x = 1 + 2; x * 3;");
+  BOOST_CHECK(first == again);
+  BOOST_CHECK_EQUAL(first->program->to_string(), "let x = (1 + 2);(x * 3)");
+  BOOST_CHECK(first->errors.empty());
+
+  auto broken = cache.parse("let = 5;");
+  BOOST_CHECK(!broken->errors.empty());
+  BOOST_CHECK(cache.parse("let = 5;") == broken);
+
+  auto stats = cache.stats();
+  BOOST_CHECK_EQUAL(stats.hits, 2u);
+  BOOST_CHECK_EQUAL(stats.misses, 2u);
+  BOOST_CHECK_EQUAL(stats.entries, 2u);
+  BOOST_CHECK_EQUAL(stats.bytes, first->footprint + broken->footprint);
+
+  // Room for about two entries: the least recently used one goes first.
+  ParseCache small(first->footprint * 2 + first->footprint / 2);
+  auto a = small.parse("1 + 1");
+  auto b = small.parse("2 + 2");
+  small.parse("1 + 1");
+  small.parse("3 + 3");
+  stats = small.stats();
+  BOOST_CHECK_EQUAL(stats.evictions, 1u);
+  BOOST_CHECK_EQUAL(stats.entries, 2u);
+  BOOST_CHECK(small.parse("1 + 1") == a);
+  BOOST_CHECK(small.parse("2 + 2") != b);
+  // An evicted program stays valid for whoever still holds it.
+  BOOST_CHECK_EQUAL(b->program->to_string(), "(2 + 2)");
+
+  ParseCache shared;
+  std::vector<std::thread> workers;
+  std::vector<std::string> results(4);
+  for (size_t t = 0; t < results.size(); t++) {
+    workers.emplace_back([&, t] {
+      for (int i = 0; i < 200; i++) {
+        auto text = "let v = " + std::to_string(i % 10) + ";";
+        results[t] += shared.parse(text)->program->to_string();
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (auto &result : results) {
+    BOOST_CHECK_EQUAL(result, results[0]);
+  }
+  stats = shared.stats();
+  BOOST_CHECK_EQUAL(stats.hits + stats.misses, 800u);
+  BOOST_CHECK_EQUAL(stats.entries, 10u);
+}
+
+BOOST_AUTO_TEST_CASE(TestCompiledProgramFormat) {
+  namespace mkc = monkey::parser::mkc;
+  monkey::lexer::Lexer l(
+      "let add = fn(a, b) { a + b }; if (add(1, 2) > 2) { [\"yes\", -1] }");
+  Parser p(&l);
+  auto program = p.parseProgram();
+  auto tree = monkey::parser::flat::flatten(*program);
+  auto bytes = mkc::serialize(tree);
+
+  auto loaded = mkc::deserialize(monkey::lexer::makeSource(bytes));
+  auto rebuilt = monkey::parser::flat::unflatten(loaded);
+  BOOST_CHECK_EQUAL(rebuilt->to_string(), program->to_string());
+  auto let = getAs<LetStatement>(rebuilt->statements[0].get());
+  BOOST_CHECK_EQUAL(let->name->symbol, monkey::lexer::intern("add"));
+
+  auto path = (std::filesystem::temp_directory_path() /
+               ("monkey_test_" + std::to_string(getpid()) + ".mkc"))
+                  .string();
+  mkc::write(path, tree);
+  BOOST_CHECK_EQUAL(mkc::recordedHash(path),
+                    mkc::hashSource(program->source->text()));
+  auto mapped = mkc::load(path);
+  std::filesystem::remove(path);
+  BOOST_CHECK(mapped->source->isMapped());
+  BOOST_CHECK_EQUAL(mapped->to_string(), program->to_string());
+
+  auto reject = [](std::string corrupt) {
+    BOOST_CHECK_THROW(mkc::deserialize(monkey::lexer::makeSource(corrupt)),
+                      mkc::FormatError);
+  };
+  reject("");
+  reject(bytes.substr(0, bytes.size() - 8));
+  auto badMagic = bytes;
+  badMagic[0] = 'X';
+  reject(badMagic);
+  mkc::Header header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  // Make the first let its own value: a cycle.
+  auto cyclic = bytes;
+  auto value = header.nodesOffset + offsetof(monkey::parser::flat::Node, b);
+  std::memset(&cyclic[value], 0, sizeof(uint32_t));
+  reject(cyclic);
+  auto changedText = bytes;
+  changedText[header.sourceOffset] = 'j';
+  reject(changedText);
+
+  // The hash is FNV-1a, the same in every build.
+  BOOST_CHECK_EQUAL(mkc::hashSource(""), 0xcbf29ce484222325);
+  BOOST_CHECK_EQUAL(mkc::hashSource("a"), 0xaf63dc4c8601ec8c);
+
+  // A statement of `-` applied levels - 2 times to 1, built by hand since
+  // the parser would not nest that deep.
+  namespace flat = monkey::parser::flat;
+  auto negations = [](size_t levels) {
+    flat::Tree tall;
+    tall.source = monkey::lexer::makeSource("-1");
+    using monkey::lexer::TokenType;
+    tall.nodes.push_back({flat::Tag::EXPRESSION, TokenType::MINUS, 0, 1, 1});
+    for (flat::Index i = 1; i < levels - 1; i++) {
+      tall.nodes.push_back({flat::Tag::PREFIX, TokenType::MINUS, 0, 1, i + 1});
+    }
+    tall.nodes.push_back({flat::Tag::INTEGER, TokenType::INT, 1, 1});
+    tall.statements.push_back(0);
+    return mkc::serialize(tall);
+  };
+  auto tallest = mkc::deserialize(
+      monkey::lexer::makeSource(negations(Parser::kDefaultMaxHeight)));
+  BOOST_CHECK_EQUAL(flat::unflatten(tallest)->statements.size(), 1);
+  reject(negations(Parser::kDefaultMaxHeight + 1));
+  reject(negations(2000000));
+}
+
+BOOST_AUTO_TEST_CASE(TestReparseMatchesFullParse) {
+  std::string base;
+  for (int i = 0; i < 40; i++) {
+    auto n = std::to_string(i);
+    base += "let f = fn(a, b) { if (a < b) { a * " + n +
+            " } else { [a, \"s\"] } };\nf(" + n + ", 2);\n";
+  }
+  // Fragments that split, join, break and repair statements.
+  std::vector<std::string> fragments = {"",  "1", ";", "}", "{", "let x = ",
+                                        "(", " + 2", "fn(y) { y }", "\n"};
+  std::mt19937 random(7);
+  auto expectSame = [](const ParsedScript &got, const std::string &text) {
+    auto expected = parseScript(monkey::lexer::makeSource(text));
+    BOOST_REQUIRE_EQUAL(got.tokens.source()->text(), text);
+    BOOST_REQUIRE(got.errors == expected.errors);
+    BOOST_REQUIRE(got.statementStarts == expected.statementStarts);
+    // Trees with errors may hold null children that to_string cannot print.
+    if (expected.errors.empty()) {
+      BOOST_REQUIRE_EQUAL(got.program->to_string(),
+                          expected.program->to_string());
+    }
+  };
+
+  auto parsed = parseScript(monkey::lexer::makeSource(base));
+  BOOST_REQUIRE(parsed.errors.empty());
+  std::string text = base;
+  int clean = 0;
+  for (int i = 0; i < 300; i++) {
+    auto offset = random() % (text.size() + 1);
+    auto removed = std::min<size_t>(random() % 4, text.size() - offset);
+    auto inserted = fragments[random() % fragments.size()];
+    auto result = reparse(parsed, {offset, removed, inserted});
+    text.replace(offset, removed, inserted);
+    expectSame(result, text);
+    clean += result.errors.empty();
+    if (!result.errors.empty()) {
+      // Go back to a clean version so most edits start from one.
+      text = base;
+      result = parseScript(monkey::lexer::makeSource(text));
+    }
+    parsed = std::move(result);
+  }
+  BOOST_CHECK_GT(clean, 40);
+
+  // Editing one function body parses that statement again, nothing else.
+  parsed = parseScript(monkey::lexer::makeSource(base));
+  auto offset = base.find("a * 20");
+  auto edited = reparse(parsed, {offset + 4, 0, "1"});
+  text = base;
+  text.insert(offset + 4, "1");
+  expectSame(edited, text);
+  BOOST_CHECK_EQUAL(edited.reusedStatements,
+                    edited.program->statements.size() - 1);
+  BOOST_CHECK(edited.program->statements[0].get() ==
+              parsed.program->statements[0].get());
+  BOOST_CHECK(edited.program->statements.back().get() ==
+              parsed.program->statements.back().get());
+  // The shared statements outlive the version they came from.
+  auto expected = edited.program->to_string();
+  parsed = ParsedScript();
+  BOOST_CHECK_EQUAL(edited.program->to_string(), expected);
+  BOOST_CHECK_THROW(reparse(parsed, {0, 0, "x"}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelParseMatchesSequential) {
+  std::string base;
+  for (int i = 0; i < 60; i++) {
+    auto n = std::to_string(i);
+    base += "let f = fn(a) { let b = a * " + n + "; return b; };\n";
+    base += "if (f(" + n + ") > 10) { 1 } else { 2 }\nreturn f;\n";
+  }
+  // Fragments that unbalance brackets or merge statements, so some parts
+  // start where the sequential parser does not.
+  std::vector<std::string> fragments = {"{", "}", "(", ")", "[", ";", "let",
+                                        "= ", "return", "fn(x) {"};
+  std::mt19937 random(11);
+  std::vector<std::string> inputs = {base, "", "let x = 1;"};
+  for (int i = 0; i < 60; i++) {
+    auto text = base;
+    for (int j = 0; j < 3; j++) {
+      text.insert(random() % (text.size() + 1),
+                  fragments[random() % fragments.size()]);
+    }
+    inputs.push_back(text);
+  }
+
+  for (const auto &text : inputs) {
+    auto source = monkey::lexer::makeSource(text);
+    auto tokens = monkey::lexer::Lexer(source).tokenizeAll();
+    Parser sequential(&tokens);
+    auto expected = sequential.parseProgram();
+    auto starts = [&](const Program &program) {
+      std::vector<size_t> offsets;
+      for (const auto &statement : program.statements) {
+        offsets.push_back(statement->literal().data() - text.data());
+      }
+      return offsets;
+    };
+    for (unsigned threads : {2, 3, 8}) {
+      Parser p(&tokens);
+      auto program = p.parseProgram(threads, 8);
+      BOOST_REQUIRE(p.getErrors() == sequential.getErrors());
+      BOOST_REQUIRE(starts(*program) == starts(*expected));
+      BOOST_REQUIRE(p.atEnd());
+      // Trees with errors may hold null children that to_string cannot print.
+      if (sequential.getErrors().empty()) {
+        BOOST_REQUIRE_EQUAL(program->to_string(), expected->to_string());
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestDeepNestingIsAParseError) {
+  const size_t deep = 100000;
+  auto parse = [](const std::string &input, size_t maxDepth,
+                  size_t maxHeight = Parser::kDefaultMaxHeight) {
+    monkey::lexer::Lexer l(input);
+    Parser p(&l);
+    p.setMaxDepth(maxDepth);
+    p.setMaxHeight(maxHeight);
+    auto program = p.parseProgram();
+    return std::make_pair(std::move(program), p.getErrors());
+  };
+  std::string tooDeep = "nesting exceeds the maximum depth of " +
+                        std::to_string(Parser::kDefaultMaxDepth);
+  std::vector<std::string> nested = {
+      std::string(deep, '(') + "1" + std::string(deep, ')'),
+      "let x = " + std::string(deep, '-') + "1",
+      "return " + std::string(deep, '[') + std::string(deep, ']'),
+      "f" + std::string(deep, '(') + std::string(deep, ')'),
+  };
+  std::string function;
+  for (size_t i = 0; i < deep / 10; i++) {
+    function += "fn() { if (x) { ";
+  }
+  function += std::string(deep / 10 * 2, '}');
+  nested.push_back(function);
+
+  for (const auto &input : nested) {
+    // The statement after the one nested too deeply is still parsed.
+    auto [program, errors] =
+        parse(input + "; let after = 1;", Parser::kDefaultMaxDepth);
+    BOOST_REQUIRE_EQUAL(errors.size(), 1);
+    BOOST_CHECK_EQUAL(errors[0], tooDeep);
+    BOOST_REQUIRE_EQUAL(program->statements.size(), 1);
+    BOOST_CHECK_EQUAL(program->to_string(), "let after = 1;");
+  }
+
+  // Chains never nest the parse, but their trees are as tall.
+  std::string tooTall = "expression tree exceeds the maximum height of " +
+                        std::to_string(Parser::kDefaultMaxHeight);
+  std::string sum = "1";
+  std::string calls = "f";
+  for (size_t i = 0; i < deep; i++) {
+    sum += " + 1";
+    calls += "()";
+  }
+  for (const auto &input : {sum, "let y = " + calls}) {
+    auto [program, errors] =
+        parse(input + "; let after = 1;", Parser::kDefaultMaxDepth);
+    BOOST_REQUIRE_EQUAL(errors.size(), 1);
+    BOOST_CHECK_EQUAL(errors[0], tooTall);
+    BOOST_REQUIRE_EQUAL(program->statements.size(), 1);
+    BOOST_CHECK_EQUAL(program->to_string(), "let after = 1;");
+  }
+  // Well past the nesting limit, a chain is still fine.
+  auto [chain, chainErrors] =
+      parse(sum.substr(0, 4 * 5000 + 1) + ";", Parser::kDefaultMaxDepth);
+  BOOST_CHECK(chainErrors.empty());
+  BOOST_CHECK_EQUAL(chain->statements.size(), 1);
+
+  // Parentheses make no nodes, so deep groups are fine once allowed.
+  auto [program, errors] = parse(nested[0], 4 * deep);
+  BOOST_CHECK(errors.empty());
+  BOOST_CHECK_EQUAL(program->to_string(), "1");
+
+  std::tie(program, errors) = parse("1 + (2 * (3 - (4)));", 13);
+  BOOST_CHECK_EQUAL(errors.size(), 1);
+  std::tie(program, errors) = parse("1 + (2 * (3 - (4)));", 14);
+  BOOST_CHECK(errors.empty());
+  BOOST_CHECK_EQUAL(program->to_string(), "(1 + (2 * (3 - 4)))");
+  // Statement, then one level per operator, then the last operand.
+  std::tie(program, errors) =
+      parse("1 + 2 + 3 + 4;", Parser::kDefaultMaxDepth, 4);
+  BOOST_CHECK_EQUAL(errors.size(), 1);
+  std::tie(program, errors) =
+      parse("1 + 2 + 3 + 4;", Parser::kDefaultMaxDepth, 5);
+  BOOST_CHECK(errors.empty());
+
+  // A parallel parse applies the same limit as a sequential one.
+  std::string script;
+  for (int i = 0; i < 400; i++) {
+    script += "let v = " + std::string(i % 40, '-') + "1;\n";
+  }
+  monkey::lexer::Lexer l(script);
+  auto tokens = l.tokenizeAll();
+  Parser sequential(&tokens);
+  sequential.setMaxDepth(50);
+  auto expected = sequential.parseProgram();
+  Parser parallel(&tokens);
+  parallel.setMaxDepth(50);
+  auto actual = parallel.parseProgram(4, 64);
+  BOOST_CHECK(!sequential.getErrors().empty());
+  BOOST_CHECK(parallel.getErrors() == sequential.getErrors());
+  BOOST_CHECK_EQUAL(actual->statements.size(), expected->statements.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestOptimizationLevels) {
+  auto optimize = [](const std::string &input, int level) {
+    auto l = monkey::lexer::Lexer(input);
+    auto p = Parser(&l);
+    auto program = p.parseProgram();
+    BOOST_REQUIRE(p.getErrors().empty());
+    opt::PassManager(level).run(*program);
+    return program->to_string();
+  };
+  struct Test {
+    std::string input;
+    std::string level1;
+    std::string level2;
+  };
+  std::vector<Test> tests = {
+      {"2 * (5 + 10)", "30", "30"},
+      {"-(3 - 5) * x", "(2 * x)", "(2 * x)"},
+      {"!true == (1 < 2)", "false", "false"},
+      {"!5", "false", "false"},
+      {R"("foo" + "bar" + "baz")", "foobarbaz", "foobarbaz"},
+      // Left as they are for the evaluator to report or compute.
+      {"1 / 0", "(1 / 0)", "(1 / 0)"},
+      {"9223372036854775807 + 1", "(9223372036854775807 + 1)",
+       "(9223372036854775807 + 1)"},
+      {"-true", "(-true)", "(-true)"},
+      {R"("a" == "a")", "(a == a)", "(a == a)"},
+      {"if (1 < 2) { x } else { y }", "if true x else y", "x"},
+      {"if (false) { x }; y", "if false xy", "y"},
+      {"if (false) { x }", "if false x", "if false x"},
+      {"if (\"s\") { let a = 1; a }", "if s let a = 1;a", "let a = 1;a"},
+      {"fn() { return 1 + 1; x; y }", "fn() return 2;xy", "fn() return 2;"},
+      {"fn() { if (true) { return 1; } 2 }",
+       "fn() if true return 1;2", "fn() return 1;"},
+  };
+  for (const auto &[input, level1, level2] : tests) {
+    BOOST_CHECK_EQUAL(optimize(input, 1), level1);
+    BOOST_CHECK_EQUAL(optimize(input, 2), level2);
+  }
+
+  BOOST_CHECK_EQUAL(optimize("2 * (5 + 10)", 0), "(2 * (5 + 10))");
+
+  std::ostringstream dump;
+  auto l = monkey::lexer::Lexer("1 + 2 * 3");
+  auto program = Parser(&l).parseProgram();
+  BOOST_CHECK_EQUAL(opt::PassManager(2).run(*program, &dump), 2);
+  BOOST_CHECK_EQUAL(dump.str(), "before: (1 + (2 * 3))\n"
+                                "fold-constants: 2 rewrites\n"
+                                "after: 7\n");
+  BOOST_CHECK_THROW(opt::PassManager(3), std::invalid_argument);
+  Program handBuilt;
+  BOOST_CHECK_THROW(opt::PassManager().run(handBuilt), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestResolveScopes) {
+  auto l = monkey::lexer::Lexer(
+      "let g = 1; fn(a, b) { let c = a; fn(d) { a + c + d + g } }");
+  auto program = Parser(&l).parseProgram();
+  resolveScopes(program->statements);
+
+  auto let = getAs<LetStatement>(program->statements[0].get());
+  BOOST_CHECK(let->name->binding == Binding::GLOBAL);
+  auto outer = getAs<FunctionLiteral>(
+      getAs<ExpressionStatement>(program->statements[1].get())
+          ->expression.get());
+  BOOST_CHECK(outer->resolved);
+  BOOST_CHECK_EQUAL(outer->slots.size(), 3);
+  BOOST_CHECK_EQUAL(outer->parameters[1]->slot, 1);
+  auto innerLet = getAs<LetStatement>(outer->body->statements[0].get());
+  BOOST_CHECK(innerLet->name->binding == Binding::LOCAL);
+  BOOST_CHECK_EQUAL(innerLet->name->slot, 2);
+
+  auto inner = getAs<FunctionLiteral>(
+      getAs<ExpressionStatement>(outer->body->statements[1].get())
+          ->expression.get());
+  BOOST_CHECK_EQUAL(inner->slots.size(), 1);
+  // ((a + c) + d) + g
+  auto sum = getAs<InfixExpression>(
+      getAs<ExpressionStatement>(inner->body->statements[0].get())
+          ->expression.get());
+  auto g = getAs<Identifier>(sum->right.get());
+  BOOST_CHECK(g->binding == Binding::GLOBAL);
+  BOOST_CHECK_EQUAL(g->depth, 2);
+  sum = getAs<InfixExpression>(sum->left.get());
+  auto d = getAs<Identifier>(sum->right.get());
+  BOOST_CHECK(d->binding == Binding::LOCAL);
+  BOOST_CHECK_EQUAL(d->depth, 0);
+  BOOST_CHECK_EQUAL(d->slot, 0);
+  sum = getAs<InfixExpression>(sum->left.get());
+  auto a = getAs<Identifier>(sum->left.get());
+  auto c = getAs<Identifier>(sum->right.get());
+  BOOST_CHECK(a->binding == Binding::LOCAL && c->binding == Binding::LOCAL);
+  BOOST_CHECK_EQUAL(a->depth, 1);
+  BOOST_CHECK_EQUAL(a->slot, 0);
+  BOOST_CHECK_EQUAL(c->depth, 1);
+  BOOST_CHECK_EQUAL(c->slot, 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestInlineFunctions) {
+  auto optimize = [](const std::string &input, bool wholeProgram = true) {
+    auto l = monkey::lexer::Lexer(input);
+    auto program = Parser(&l).parseProgram();
+    std::ostringstream log;
+    opt::PassManager(2, wholeProgram).run(*program, nullptr, &log);
+    return std::make_pair(program->to_string(), log.str());
+  };
+  std::string add = "let add = fn(a, b) { a + b }; ";
+  std::string addTree = "let add = fn(a, b) (a + b);";
+
+  auto [tree, log] = optimize(add + "add(2, 3)");
+  BOOST_CHECK_EQUAL(tree, addTree + "5");
+  BOOST_CHECK_EQUAL(log, "1:31: inlined add\n");
+  std::tie(tree, log) = optimize("let x = 2; " + add + "fn(y) { add(x, y) }");
+  BOOST_CHECK_EQUAL(tree, "let x = 2;" + addTree + "fn(y) (x + y)");
+  // Functions bound in a function are inlined into later statements of it.
+  std::tie(tree, log) =
+      optimize("fn(y) { let twice = fn(a) { a * 2 }; twice(y) }", false);
+  BOOST_CHECK_EQUAL(tree, "fn(y) let twice = fn(a) (a * 2);(y * 2)");
+
+  struct Test {
+    std::string input;
+    std::string reason;
+  };
+  std::vector<Test> tests = {
+      {"add(1, 2); " + add, "it may be called before it is bound"},
+      {add + "let add = fn(a, b) { a }; add(1, 2)",
+       "it is bound more than once"},
+      {add + "add(1)", "it takes 2 arguments, not 1"},
+      {add + "add(1, fn() { 2 })",
+       "argument 2 is neither a literal nor a bound name"},
+      {add + "add(1, z)", "argument 2 is neither a literal nor a bound name"},
+      {"let k = 1; let add = fn(a, b) { a + k }; fn(k) { add(k, 1) }",
+       "k means something else here"},
+      {"let add = fn(a, b) { let c = a; c }; add(1, 2)",
+       "its body is not a single expression"},
+      {"let add = fn(a, b) { if (a) { return b; } }; add(1, 2)",
+       "its body binds names or returns"},
+      {"let add = fn(a, b) { fn() { a } }; add(1, 2)",
+       "its body makes a closure"},
+      {"let add = fn(a, b) { a + b + a + b + a + b + a + b + a }; add(1, 2)",
+       "its body has 17 nodes, over the budget of 16"},
+      {"let add = fn(a, b) { if (a) { add(a, b) } }; add(1, 2)",
+       "it refers to itself"},
+  };
+  for (const auto &[input, reason] : tests) {
+    std::tie(tree, log) = optimize(input);
+    BOOST_CHECK_NE(tree.find("add("), std::string::npos);
+    BOOST_CHECK_MESSAGE(log.find("not inlining add: " + reason + "\n") !=
+                            std::string::npos,
+                        input << " logged " << log);
+  }
+  std::tie(tree, log) = optimize(add + "add(2, 3)", false);
+  BOOST_CHECK_EQUAL(tree, addTree + "add(2, 3)");
+  BOOST_CHECK_EQUAL(log, "1:31: not inlining add: later input may rebind it\n");
+}